@@ -70,7 +70,8 @@ struct channel
     struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
-    struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    bool completion_pending;    /* Interrupt seen, waiter not yet woken. */
+    struct semaphore completion_wait;   /* Up'd by softirq. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
@@ -96,6 +97,7 @@ static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static softirq_func completion_softirq;
 
 /* Initialize the disk subsystem and detect disks. */
 void
@@ -123,8 +125,9 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      lock_init_named (&c->lock, c->name);
       c->expecting_interrupt = false;
+      c->completion_pending = false;
       sema_init (&c->completion_wait, 0);
 
       /* Initialize devices. */
@@ -140,6 +143,8 @@ ide_init (void)
 
       /* Register interrupt handler. */
       intr_register_ext (c->irq, interrupt_handler, c->name);
+      if (chan_no == 0)
+        softirq_register (SOFTIRQ_BLOCK, completion_softirq);
 
       /* Reset hardware. */
       reset_channel (c);
@@ -514,7 +519,8 @@ interrupt_handler (struct intr_frame *f)
         if (c->expecting_interrupt)
           {
             inb (reg_status (c));               /* Acknowledge interrupt. */
-            sema_up (&c->completion_wait);      /* Wake up waiter. */
+            c->completion_pending = true;       /* Wake up waiter... */
+            softirq_raise (SOFTIRQ_BLOCK);      /* ...after we return. */
           }
         else
           printf ("%s: unexpected interrupt\n", c->name);
@@ -523,3 +529,22 @@ interrupt_handler (struct intr_frame *f)
 
   NOT_REACHED ();
 }
+
+/* Block softirq.  Wakes the thread waiting on each channel whose
+   interrupt has arrived. */
+static void
+completion_softirq (void)
+{
+  struct channel *c;
+
+  for (c = channels; c < channels + CHANNEL_CNT; c++)
+    {
+      enum intr_level old_level = intr_disable ();
+      bool pending = c->completion_pending;
+      c->completion_pending = false;
+      intr_set_level (old_level);
+
+      if (pending)
+        sema_up (&c->completion_wait);
+    }
+}
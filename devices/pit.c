@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -30,6 +27,11 @@
 
    MODE specifies the form of output:
 
+     - Mode 0 is a one-shot countdown: the channel's output
+       rises once, when the count reaches 0, and stays high.
+       Hooked up to the interrupt controller, this yields a
+       single interrupt after a chosen delay.
+
      - Mode 2 is a periodic pulse: the channel's output is 1 for
        most of the period, but drops to 0 briefly toward the end
        of the period.  This is useful for hooking up to an
@@ -46,9 +48,7 @@ void
 pit_configure_channel (int channel, int mode, int frequency)
 {
   uint16_t count;
-  enum intr_level old_level;
 
-  ASSERT (channel == 0 || channel == 2);
   ASSERT (mode == 2 || mode == 3);
 
   /* Convert FREQUENCY to a PIT counter value.  The PIT has a
@@ -74,6 +74,21 @@ pit_configure_channel (int channel, int mode, int frequency)
   else
     count = (PIT_HZ + frequency / 2) / frequency;
 
+  pit_load_channel (channel, mode, count);
+}
+
+/* Configures CHANNEL in the PIT in the given MODE, as described
+   for pit_configure_channel(), and starts it counting down from
+   COUNT cycles of the PIT's PIT_HZ clock.  A COUNT of 0 stands
+   for 65536. */
+void
+pit_load_channel (int channel, int mode, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (mode == 0 || mode == 2 || mode == 3);
+
   /* Configure the PIT mode and load its counters. */
   old_level = intr_disable ();
   outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (mode << 1));
@@ -81,3 +96,19 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Gives CHANNEL, which must be running in mode 2 or 3, a new
+   COUNT without disturbing the period in progress.  The new
+   count takes effect when the current period ends. */
+void
+pit_reload_channel (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
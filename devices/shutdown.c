@@ -5,6 +5,9 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/memstat.h"
+#include "threads/profile.h"
+#include "threads/trace.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -95,6 +98,8 @@ shutdown_power_off (void)
 #endif
 
   print_stats ();
+  profile_dump ();
+  trace_dump ();
 
   printf ("Powering off...\n");
   serial_flush ();
@@ -127,6 +132,7 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  thread_print_sched_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -135,4 +141,8 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef LOCK_STATS
+  lock_print_stats ();
+#endif
+  memstat_print_stats ();
 }
@@ -5,8 +5,11 @@
 #include <stdio.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -20,50 +23,121 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* Last tick whose sleepers have been woken.  Wakeups run in the
+   timer softirq, which may fall behind TICKS if interrupts
+   arrive faster than softirqs can be run. */
+static int64_t wake_tick;
+
+/* Time-stamp counter clocksource.  The TSC's rate is measured
+   against the PIT by timer_calibrate().  Until then TSC_HZ is 0,
+   so timer_now_ns() returns 0 and brief delays do not wait.
+
+   timer_now_ns() converts cycles to nanoseconds by multiplying
+   by TSC_NS_MULT and shifting right by TSC_NS_SHIFT, which avoids
+   a 64-bit division on every call.  A shift of 20 leaves the
+   product of a 32-bit cycle count and TSC_NS_MULT within 64 bits
+   for any TSC faster than 1 MHz. */
+#define TSC_NS_SHIFT 20
+#define TSC_CALIBRATE_TICKS 4   /* Length of calibration, in ticks. */
+static uint64_t tsc_hz;         /* TSC cycles per second. */
+static uint64_t tsc_base;       /* TSC at calibration. */
+static uint64_t tsc_ns_mult;    /* Nanoseconds per cycle, scaled. */
+
+/* Tickless idle.  When the idle thread finds that nothing is
+   due for the next few ticks, timer_idle_enter() switches the
+   PIT from its periodic mode to a one-shot countdown to the
+   next tick that has work, and the ticks in between are never
+   delivered.  The next external interrupt, whether the countdown
+   running out or some other device, calls timer_idle_exit(),
+   which credits the skipped ticks as measured by the TSC and
+   puts the PIT back on its periodic schedule, in phase with the
+   ticks it skipped.
+
+   The PIT's 16-bit counter limits a countdown to about 55 ms,
+   that is, to NOHZ_MAX_TICKS ticks. */
+#define PIT_TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define NOHZ_MAX_TICKS (65535 / PIT_TICK_COUNT)
+bool timer_tickless = true;     /* Set false to tick while idle. */
+static int nohz_ticks;          /* Length of countdown, or 0. */
+static uint64_t tick_tsc;       /* TSC at the most recent tick. */
+static int64_t skipped_ticks;   /* Ticks never delivered. */
+
+/* Threads blocked in timer_sleep(), hashed into a timer wheel by
+   wakeup tick.  Slot I holds the sleepers whose wakeup tick is
+   congruent to I modulo SLEEP_WHEEL_SIZE, in ascending order of
+   wakeup tick, so each timer interrupt need only look at the
+   front of a single slot.  Access with interrupts off. */
+#define SLEEP_WHEEL_SIZE 64     /* Must be a power of 2. */
+static struct list sleep_wheel[SLEEP_WHEEL_SIZE];
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static struct list *sleep_slot (int64_t tick);
+static bool wakeup_less (const struct list_elem *, const struct list_elem *,
+                         void *aux);
+static void wake_sleepers (int64_t tick);
+static int ticks_until_due (int max);
+static softirq_func timer_softirq;
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void)
 {
+  size_t i;
+
+  for (i = 0; i < SLEEP_WHEEL_SIZE; i++)
+    list_init (&sleep_wheel[i]);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+  softirq_register (SOFTIRQ_TIMER, timer_softirq);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Measures the rate of the time-stamp counter against the
+   timer, for timer_now_ns() and brief delays. */
 void
 timer_calibrate (void)
 {
-  unsigned high_bit, test_bit;
+  int64_t start;
+  uint64_t tsc_start;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1))
-    {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
-    }
+  /* Count TSC cycles across TSC_CALIBRATE_TICKS whole ticks,
+     starting just after a tick boundary. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  tsc_start = rdtsc ();
+  start = ticks;
+  while (ticks - start < TSC_CALIBRATE_TICKS)
+    barrier ();
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops (high_bit | test_bit))
-      loops_per_tick |= test_bit;
+  tsc_base = rdtsc ();
+  tsc_hz = (tsc_base - tsc_start) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+  ASSERT (tsc_hz > 0);
+  tsc_ns_mult = ((uint64_t) 1000000000 << TSC_NS_SHIFT) / tsc_hz;
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" cycles/s.\n", tsc_hz);
+}
+
+/* Returns the number of nanoseconds since timer_calibrate() was
+   called, or 0 if it has not been called yet. */
+uint64_t
+timer_now_ns (void)
+{
+  uint64_t cycles;
+
+  if (tsc_hz == 0)
+    return 0;
+
+  /* Multiply in two halves so that the product cannot overflow. */
+  cycles = rdtsc () - tsc_base;
+  return (((cycles >> 32) * tsc_ns_mult) << (32 - TSC_NS_SHIFT))
+          + (((cycles & 0xffffffff) * tsc_ns_mult) >> TSC_NS_SHIFT);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -85,15 +159,27 @@ timer_elapsed (int64_t then)
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The calling thread is blocked on the sleep wheel until the
+   timer interrupt handler finds that its wakeup tick has
+   arrived, so it uses no CPU time while asleep. */
 void
 timer_sleep (int64_t ticks)
 {
-  int64_t start = timer_ticks ();
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks)
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  cur->wakeup_tick = timer_ticks () + ticks;
+  list_insert_ordered (sleep_slot (cur->wakeup_tick), &cur->elem,
+                       wakeup_less, NULL);
+  thread_block ();
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -159,52 +245,197 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before
+   it halts the CPU.  If no sleeper or delayed work is due within
+   the next tick, stops the periodic timer interrupt until the
+   next tick that is. */
+void
+timer_idle_enter (void)
+{
+  uint64_t cycles_per_tick = tsc_hz / TIMER_FREQ;
+  uint64_t since_tick;
+  int n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || tsc_hz == 0 || profile_enabled
+      || nohz_ticks != 0 || wake_tick < ticks)
+    return;
+
+  /* Give up if the next tick is already close or overdue. */
+  since_tick = rdtsc () - tick_tsc;
+  if (since_tick >= cycles_per_tick / 2)
+    return;
+
+  n = ticks_until_due (NOHZ_MAX_TICKS);
+  if (n < 2)
+    return;
+
+  nohz_ticks = n;
+  pit_load_channel (0, 0, n * PIT_TICK_COUNT
+                          - since_tick * PIT_HZ / tsc_hz);
+}
+
+/* Called at the start of every external interrupt, with vector
+   number VEC_NO.  If the timer was stopped by timer_idle_enter(),
+   accounts for the ticks that passed meanwhile and restarts the
+   periodic timer interrupt. */
+void
+timer_idle_exit (uint8_t vec_no)
+{
+  int skip;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (nohz_ticks == 0)
+    return;
+
+  if (vec_no == 0x20)
+    {
+      /* The countdown ran out.  This interrupt is the tick it
+         was counting down to, so it is at a tick boundary. */
+      skip = nohz_ticks - 1;
+      pit_load_channel (0, 2, PIT_TICK_COUNT);
+    }
+  else
+    {
+      /* Some other device woke us.  Credit the whole ticks that
+         have passed, then time the first periodic interrupt to
+         land where the next tick would have. */
+      uint64_t cycles_per_tick = tsc_hz / TIMER_FREQ;
+      uint64_t since_tick = rdtsc () - tick_tsc;
+      uint64_t left;
+
+      skip = since_tick / cycles_per_tick;
+      if (skip > nohz_ticks - 1)
+        skip = nohz_ticks - 1;
+      tick_tsc += skip * cycles_per_tick;
+      left = (cycles_per_tick - (since_tick - skip * cycles_per_tick))
+             * PIT_HZ / tsc_hz;
+      if (left < 2)
+        left = 2;
+      else if (left > PIT_TICK_COUNT)
+        left = PIT_TICK_COUNT;
+
+      pit_load_channel (0, 2, left);
+      pit_reload_channel (0, PIT_TICK_COUNT);
+    }
+  nohz_ticks = 0;
+
+  if (skip > 0)
+    {
+      skipped_ticks += skip;
+      while (skip-- > 0)
+        {
+          ticks++;
+          thread_tick ();
+        }
+      softirq_raise (SOFTIRQ_TIMER);
+    }
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void)
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" skipped while idle\n",
+          timer_ticks (), skipped_ticks);
 }
-
+
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
   ticks++;
+  tick_tsc = rdtsc ();
+  profile_sample (args);
+  softirq_raise (SOFTIRQ_TIMER);
   thread_tick ();
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-static bool
-too_many_loops (unsigned loops)
+/* Timer softirq.  Wakes sleeping threads and queues delayed
+   work for every tick since the last time it ran, turning
+   interrupts back on between ticks. */
+static void
+timer_softirq (void)
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier ();
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      int64_t tick;
+
+      if (wake_tick >= ticks)
+        {
+          intr_set_level (old_level);
+          break;
+        }
+      tick = ++wake_tick;
+      wake_sleepers (tick);
+      workqueue_tick (tick);
+      intr_set_level (old_level);
+    }
+}
 
-  /* Run LOOPS loops. */
-  start = ticks;
-  busy_wait (loops);
+/* Returns the sleep wheel slot for threads waking at TICK. */
+static struct list *
+sleep_slot (int64_t tick)
+{
+  return &sleep_wheel[tick & (SLEEP_WHEEL_SIZE - 1)];
+}
+
+/* Returns true if thread A wakes up before thread B. */
+static bool
+wakeup_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
 
-  /* If the tick count changed, we iterated too long. */
-  barrier ();
-  return start != ticks;
+  return a->wakeup_tick < b->wakeup_tick;
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Unblocks every sleeping thread whose wakeup tick is TICK.
+   Only TICK's slot can hold such threads, and they sit at its
+   front, so the cost is one comparison plus one unblock per
+   thread woken.  Interrupts must be off. */
+static void
+wake_sleepers (int64_t tick)
+{
+  struct list *slot = sleep_slot (tick);
+
+  while (!list_empty (slot))
+    {
+      struct thread *t = list_entry (list_front (slot), struct thread, elem);
+      if (t->wakeup_tick > tick)
+        break;
+      list_pop_front (slot);
+      thread_unblock (t);
+    }
+}
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops)
+/* Returns the number of ticks, counting from the current tick,
+   until the next tick at which a sleeper wakes or delayed work
+   is due, or MAX if that is further off.  Interrupts must be
+   off. */
+static int
+ticks_until_due (int max)
 {
-  while (loops-- > 0)
-    barrier ();
+  int64_t due = workqueue_next_due ();
+  int n;
+
+  for (n = 1; n < max; n++)
+    {
+      int64_t tick = ticks + n;
+      struct list *slot = sleep_slot (tick);
+
+      if (tick >= due)
+        break;
+      if (!list_empty (slot)
+          && list_entry (list_front (slot),
+                         struct thread, elem)->wakeup_tick <= tick)
+        break;
+    }
+  return n;
 }
 
 /* Sleep for approximately NUM/DENOM seconds. */
@@ -239,8 +470,9 @@ real_time_sleep (int64_t num, int32_t denom)
 static void
 real_time_delay (int64_t num, int32_t denom)
 {
-  /* Scale the numerator and denominator down by 1000 to avoid
-     the possibility of overflow. */
-  ASSERT (denom % 1000 == 0);
-  busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+  uint64_t start = rdtsc ();
+  uint64_t cycles = tsc_hz * num / denom;
+
+  while (rdtsc () - start < cycles)
+    asm volatile ("pause");
 }
@@ -27,6 +27,8 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+void dir_init (void);
+
 /* Opening and closing directories. */
 bool dir_create (block_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
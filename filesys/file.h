@@ -12,6 +12,8 @@ struct file
     bool deny_write;            /* Has file_deny_write() been called? */
   };
 
+void file_init (void);
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
@@ -27,6 +27,7 @@ typedef unsigned long elem_type;
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
+    size_t next_fit;    /* Where bitmap_scan_and_flip_next() starts. */
     elem_type *bits;    /* Elements that represent bits. */
   };
 
@@ -69,6 +70,33 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns the number of bits set to 1 in E, which must be 32
+   bits wide, as elem_type is on the 80x86. */
+static inline size_t
+elem_popcount (elem_type e)
+{
+  e = e - ((e >> 1) & 0x55555555);
+  e = (e & 0x33333333) + ((e >> 2) & 0x33333333);
+  e = (e + (e >> 4)) & 0x0f0f0f0f;
+  return (e * 0x01010101) >> 24;
+}
+
+/* Returns a mask of the bits in the element holding bit START
+   that lie between START and START + CNT, exclusive.  The range
+   must not extend past the end of that element. */
+static inline elem_type
+range_mask (size_t start, size_t cnt)
+{
+  elem_type mask = (cnt < ELEM_BITS
+                    ? ((elem_type) 1 << cnt) - 1 : (elem_type) -1);
+  return mask << (start % ELEM_BITS);
+}
+
+static size_t find_next (const struct bitmap *, size_t start, size_t end,
+                         bool value);
+static size_t scan_range (const struct bitmap *, size_t start, size_t end,
+                          size_t cnt, bool value);
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -82,6 +110,7 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->next_fit = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -104,6 +133,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
   ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
   b->bit_cnt = bit_cnt;
+  b->next_fit = 0;
   b->bits = (elem_type *) (b + 1);
   bitmap_set_all (b, false);
   return b;
@@ -213,18 +243,34 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.  Each
+   element is updated atomically, a whole element at a time. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-  size_t i;
-
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (cnt > 0)
+    {
+      size_t idx = elem_idx (start);
+      size_t n = ELEM_BITS - start % ELEM_BITS;
+      elem_type mask;
+
+      if (n > cnt)
+        n = cnt;
+      mask = range_mask (start, n);
+
+      /* See bitmap_mark() and bitmap_reset(). */
+      if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+
+      start += n;
+      cnt -= n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,17 +278,26 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-  size_t i, value_cnt;
+  size_t left, one_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  /* Count the bits set to true, a whole element at a time. */
+  one_cnt = 0;
+  for (left = cnt; left > 0; )
+    {
+      size_t n = ELEM_BITS - start % ELEM_BITS;
+
+      if (n > left)
+        n = left;
+      one_cnt += elem_popcount (b->bits[elem_idx (start)]
+                                & range_mask (start, n));
+      start += n;
+      left -= n;
+    }
+  return value ? one_cnt : cnt - one_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -250,16 +305,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-  size_t i;
-
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return cnt > 0 && find_next (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -298,15 +348,7 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt)
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i;
-    }
-  return BITMAP_ERROR;
+  return scan_range (b, start, b->bit_cnt, cnt, value);
 }
 
 /* Finds the first group of CNT consecutive bits in B at or after
@@ -324,6 +366,96 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Like bitmap_scan_and_flip(), but searches "next fit": starting
+   just past the group found by the previous call, and wrapping
+   around to the beginning of B if no group is found before its
+   end.  Repeated allocations from a mostly full bitmap then need
+   not rescan the full prefix each time. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t start, idx;
+
+  ASSERT (b != NULL);
+
+  start = b->next_fit <= b->bit_cnt ? b->next_fit : 0;
+  idx = scan_range (b, start, b->bit_cnt, cnt, value);
+  if (idx == BITMAP_ERROR && start > 0)
+    {
+      /* Wrap around, up to the last group that could have begun
+         before START. */
+      size_t end = start + cnt - 1;
+      if (end > b->bit_cnt)
+        end = b->bit_cnt;
+      idx = scan_range (b, 0, end, cnt, value);
+    }
+
+  if (idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (b, idx, cnt, !value);
+      b->next_fit = idx + cnt;
+    }
+  return idx;
+}
+
+/* Returns the index of the first bit in B at or after START, and
+   before END, that is set to VALUE, or END if there is none.
+   Skips a whole element at a time where possible. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t idx, last_idx, bit;
+  elem_type e;
+
+  if (start >= end)
+    return end;
+
+  /* E has a 1 wherever the bitmap has VALUE.  Mask off the bits
+     before START in its first element. */
+  idx = elem_idx (start);
+  last_idx = elem_idx (end - 1);
+  e = (b->bits[idx] ^ flip) & ((elem_type) -1 << (start % ELEM_BITS));
+  while (e == 0)
+    {
+      if (++idx > last_idx)
+        return end;
+      e = b->bits[idx] ^ flip;
+    }
+
+  bit = idx * ELEM_BITS + __builtin_ctzl (e);
+  return bit < end ? bit : end;
+}
+
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B that are all set to VALUE and lie at or
+   after START and before END.  If there is no such group,
+   returns BITMAP_ERROR.  If CNT is zero, returns START. */
+static size_t
+scan_range (const struct bitmap *b, size_t start, size_t end, size_t cnt,
+            bool value)
+{
+  ASSERT (end <= b->bit_cnt);
+
+  if (cnt == 0)
+    return start <= end ? start : BITMAP_ERROR;
+
+  while (start < end && end - start >= cnt)
+    {
+      /* Find the next run of VALUE bits and check its length. */
+      size_t run_start = find_next (b, start, end, value);
+      size_t run_end;
+
+      if (run_start == end || end - run_start < cnt)
+        break;
+      run_end = find_next (b, run_start, run_start + cnt, !value);
+      if (run_end == run_start + cnt)
+        return run_start;
+      start = run_end;
+    }
+  return BITMAP_ERROR;
+}
 
 /* File input and output. */
 
@@ -61,7 +61,17 @@ static inline void log_printf(void) {
     printf("%-" AS_STRING(LOG_MAX_BEFORE_SIZE) "s | %s%s\n", (char*)&log_before_buf, (char*)&log_buf, log_level_color(L_NONE));
 }
 
-#if LOGGING_ENABLE == 0 || LOGGING_LEVEL == 0
+#if defined KTRACE && LOGGING_LEVEL != 0
+/* In a tracing kernel, log() records a tracepoint instead of
+   printing, so that it does not disturb timing.  The message is
+   formatted offline by utils/trace-decode. */
+#include "threads/trace.h"
+#define log(LEVEL, fmt...) \
+        do { \
+            if (LOGGING_LEVEL >= (LEVEL)) \
+                TRACE(fmt); \
+        } while (0)
+#elif LOGGING_ENABLE == 0 || LOGGING_LEVEL == 0
 #define log(LEVEL, fmt...)
 #else
 #define log(LEVEL, fmt...) \
@@ -0,0 +1,28 @@
+#ifndef __LIB_SCHED_STATS_H
+#define __LIB_SCHED_STATS_H
+
+#include <stdint.h>
+
+/* Number of buckets in the wakeup latency histogram. */
+#define SCHED_LATENCY_BUCKETS 32
+
+/* Scheduler statistics, as returned by the schedstats system
+   call.  All times are in CPU clock cycles. */
+struct sched_stats
+  {
+    /* For the calling thread. */
+    uint64_t run_cycles;        /* Time spent running. */
+    uint64_t ready_cycles;      /* Time spent ready but not running. */
+    uint64_t blocked_cycles;    /* Time spent blocked. */
+    uint32_t voluntary_switches;   /* Switches away when blocking. */
+    uint32_t involuntary_switches; /* Switches away while runnable. */
+
+    /* For the whole system.  Bucket N counts the wakeups after
+       which a thread waited at least 2**N cycles, but less than
+       2**(N+1) cycles, before it ran.  Bucket 0 also counts
+       waits of 0 cycles, and the last bucket also counts all
+       longer waits. */
+    uint32_t latency_hist[SCHED_LATENCY_BUCKETS];
+  };
+
+#endif /* lib/sched-stats.h */
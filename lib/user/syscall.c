@@ -182,3 +182,9 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+schedstats (struct sched_stats *stats)
+{
+  return syscall1 (SYS_SCHEDSTATS, stats);
+}
@@ -0,0 +1,115 @@
+/* Fills a 64K-bit bitmap to 90% at random, checks bitmap_scan()
+   against a bit-by-bit search, then times a series of
+   single-bit and multi-bit allocations with first-fit
+   bitmap_scan_and_flip() and with next-fit
+   bitmap_scan_and_flip_next(). */
+
+#include <bitmap.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "devices/timer.h"
+
+#define BIT_CNT 65536           /* Bits in the bitmap. */
+#define ALLOC_CNT 1000          /* Allocations per timed run. */
+
+static void fill (struct bitmap *);
+static size_t naive_scan (const struct bitmap *, size_t start, size_t cnt);
+static void time_allocs (struct bitmap *, const char *, size_t cnt, bool next);
+
+void
+test_bitmap_bench (void)
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+  size_t i;
+
+  if (b == NULL)
+    fail ("bitmap_create() failed");
+
+  random_init (0);
+  fill (b);
+  msg ("%zu of %d bits set.", bitmap_count (b, 0, BIT_CNT, true), BIT_CNT);
+
+  for (i = 0; i < 200; i++)
+    {
+      size_t start = random_ulong () % BIT_CNT;
+      size_t cnt = random_ulong () % 4 + 1;
+      if (bitmap_scan (b, start, cnt, false) != naive_scan (b, start, cnt))
+        fail ("bitmap_scan (%zu, %zu) disagrees with naive scan",
+              start, cnt);
+    }
+  msg ("bitmap_scan() agrees with a bit-by-bit search.");
+
+  time_allocs (b, "first fit", 1, false);
+  time_allocs (b, "next fit", 1, true);
+  time_allocs (b, "first fit", 3, false);
+  time_allocs (b, "next fit", 3, true);
+
+  bitmap_destroy (b);
+}
+
+/* Sets a random 90% of the bits in B. */
+static void
+fill (struct bitmap *b)
+{
+  size_t i;
+
+  bitmap_set_all (b, true);
+  for (i = 0; i < BIT_CNT / 10; i++)
+    {
+      size_t idx;
+      do
+        idx = random_ulong () % BIT_CNT;
+      while (!bitmap_test (b, idx));
+      bitmap_reset (b, idx);
+    }
+}
+
+/* Returns the first group of CNT false bits in B at or after
+   START, testing one bit at a time. */
+static size_t
+naive_scan (const struct bitmap *b, size_t start, size_t cnt)
+{
+  size_t i, j;
+
+  for (i = start; i + cnt <= BIT_CNT; i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j))
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Allocates ALLOC_CNT groups of CNT bits from B, first fit or
+   NEXT fit, and reports how long it took.  Then frees them. */
+static void
+time_allocs (struct bitmap *b, const char *name, size_t cnt, bool next)
+{
+  static size_t allocs[ALLOC_CNT];
+  uint64_t start;
+  int i;
+
+  start = timer_now_ns ();
+  for (i = 0; i < ALLOC_CNT; i++)
+    {
+      allocs[i] = (next
+                   ? bitmap_scan_and_flip_next (b, cnt, false)
+                   : bitmap_scan_and_flip (b, 0, cnt, false));
+      if (allocs[i] == BITMAP_ERROR)
+        fail ("%s: allocation %d of %zu bits failed", name, i, cnt);
+    }
+  msg ("%s: %d allocations of %zu bits in %"PRIu64" us.",
+       name, ALLOC_CNT, cnt, (timer_now_ns () - start) / 1000);
+
+  for (i = 0; i < ALLOC_CNT; i++)
+    {
+      if (!bitmap_all (b, allocs[i], cnt))
+        fail ("%s: allocation %d not marked", name, i);
+      bitmap_set_multiple (b, allocs[i], cnt, false);
+    }
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# The times vary from run to run, so only their presence is
+# checked.
+fail "Wrong output:\n" . join ('', map ("$_\n", @output))
+  if @output != 8
+     || $output[0] ne '(bitmap-bench) begin'
+     || $output[1] ne '(bitmap-bench) 58983 of 65536 bits set.'
+     || $output[2] ne '(bitmap-bench) bitmap_scan() agrees with a bit-by-bit search.'
+     || $output[3] !~ /^\(bitmap-bench\) first fit: 1000 allocations of 1 bits in \d+ us\.$/
+     || $output[4] !~ /^\(bitmap-bench\) next fit: 1000 allocations of 1 bits in \d+ us\.$/
+     || $output[5] !~ /^\(bitmap-bench\) first fit: 1000 allocations of 3 bits in \d+ us\.$/
+     || $output[6] !~ /^\(bitmap-bench\) next fit: 1000 allocations of 3 bits in \d+ us\.$/
+     || $output[7] ne '(bitmap-bench) end';
+pass;
@@ -0,0 +1,69 @@
+/* Runs malloc() and free() in tight loops from growing numbers
+   of threads at once and reports how long each round took.
+   Exercises the per-thread magazines: most calls should be
+   satisfied without touching a descriptor's lock. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ITER_CNT 2000           /* Iterations per thread. */
+#define BLOCK_CNT 8             /* Blocks held at once per iteration. */
+
+static thread_func bench_thread;
+
+void
+test_malloc_bench (void)
+{
+  static const int thread_cnts[] = {1, 4, 16};
+  struct semaphore done;
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  for (i = 0; i < sizeof thread_cnts / sizeof *thread_cnts; i++)
+    {
+      int thread_cnt = thread_cnts[i];
+      int64_t start = timer_ticks ();
+      int j;
+
+      for (j = 0; j < thread_cnt; j++)
+        if (thread_create ("bench", PRI_DEFAULT, bench_thread, &done)
+            == TID_ERROR)
+          fail ("thread_create() failed");
+      for (j = 0; j < thread_cnt; j++)
+        sema_down (&done);
+
+      msg ("%d threads: %d allocations in %"PRId64" ticks.",
+           thread_cnt, thread_cnt * ITER_CNT * BLOCK_CNT,
+           timer_elapsed (start));
+    }
+}
+
+static void
+bench_thread (void *done_)
+{
+  struct semaphore *done = done_;
+  void *blocks[BLOCK_CNT];
+  int i, j;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      for (j = 0; j < BLOCK_CNT; j++)
+        {
+          blocks[j] = malloc (16 << (j % 6));
+          if (blocks[j] == NULL)
+            fail ("malloc() failed");
+        }
+      for (j = 0; j < BLOCK_CNT; j++)
+        free (blocks[j]);
+    }
+  sema_up (done);
+}
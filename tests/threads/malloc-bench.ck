@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# The tick counts vary from run to run, so only their presence
+# is checked.
+fail "Wrong output:\n" . join ('', map ("$_\n", @output))
+  if @output != 5
+     || $output[0] ne '(malloc-bench) begin'
+     || $output[1] !~ /^\(malloc-bench\) 1 threads: 16000 allocations in \d+ ticks\.$/
+     || $output[2] !~ /^\(malloc-bench\) 4 threads: 64000 allocations in \d+ ticks\.$/
+     || $output[3] !~ /^\(malloc-bench\) 16 threads: 256000 allocations in \d+ ticks\.$/
+     || $output[4] ne '(malloc-bench) end';
+pass;
@@ -0,0 +1,94 @@
+/* Allocates blocks from each of the size classes above 1 kB,
+   checks that they hold their contents without overlapping, and
+   checks that realloc() resizes blocks in place when their size
+   class, or for big blocks the pages around them, allow it. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+#define BLOCK_CNT 12            /* Blocks of each size at once. */
+
+static void fill (uint8_t *, size_t size, int seed);
+static void check (const uint8_t *, size_t size, int seed);
+
+void
+test_malloc_realloc (void)
+{
+  static const size_t sizes[] = {1100, 1536, 2100, 3072, 5000, 6144};
+  uint8_t *blocks[BLOCK_CNT];
+  uint8_t *p, *q;
+  size_t i, j;
+
+  /* Blocks of each large size class keep their contents. */
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      for (j = 0; j < BLOCK_CNT; j++)
+        {
+          blocks[j] = malloc (sizes[i]);
+          if (blocks[j] == NULL)
+            fail ("malloc(%zu) failed", sizes[i]);
+          fill (blocks[j], sizes[i], j);
+        }
+      for (j = 0; j < BLOCK_CNT; j++)
+        {
+          check (blocks[j], sizes[i], j);
+          free (blocks[j]);
+        }
+    }
+  msg ("Blocks of 1.5, 3, and 6 kB classes hold their contents.");
+
+  /* Resizing within a class does not move the block. */
+  p = malloc (1100);
+  fill (p, 1100, 1);
+  q = realloc (p, 1500);
+  if (q != p)
+    fail ("realloc() from 1100 to 1500 bytes moved the block");
+  check (q, 1100, 1);
+  p = realloc (q, 100);
+  if (p == q)
+    fail ("realloc() from 1500 to 100 bytes kept the large block");
+  check (p, 100, 1);
+  free (p);
+  msg ("Resized a block within its class in place.");
+
+  /* Shrinking a big block frees its tail without moving it. */
+  p = malloc (4 * PGSIZE);
+  fill (p, 4 * PGSIZE, 2);
+  q = realloc (p, 2 * PGSIZE);
+  if (q != p)
+    fail ("shrinking a big block moved it");
+  check (q, 2 * PGSIZE, 2);
+
+  /* Growing it back should find the freed pages still free. */
+  p = realloc (q, 3 * PGSIZE);
+  if (p != q)
+    fail ("growing a big block into free pages moved it");
+  check (p, 2 * PGSIZE, 2);
+  free (p);
+  msg ("Shrank and regrew a big block in place.");
+}
+
+/* Fills the SIZE bytes at P with a pattern based on SEED. */
+static void
+fill (uint8_t *p, size_t size, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    p[i] = i * 31 + seed;
+}
+
+/* Checks that the SIZE bytes at P hold the pattern written by
+   fill() with SEED. */
+static void
+check (const uint8_t *p, size_t size, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != (uint8_t) (i * 31 + seed))
+      fail ("byte %zu of block %p is corrupted", i, p);
+}
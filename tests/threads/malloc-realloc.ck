@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-realloc) begin
+(malloc-realloc) Blocks of 1.5, 3, and 6 kB classes hold their contents.
+(malloc-realloc) Resized a block within its class in place.
+(malloc-realloc) Shrank and regrew a big block in place.
+(malloc-realloc) end
+EOF
+pass;
@@ -0,0 +1,91 @@
+/* Exhausts the kernel pool one page at a time, frees the pages
+   in a scrambled order, and checks that the buddy allocator
+   merged them back into at least as many large blocks as there
+   were before.  There may be more: running out of pages makes
+   the allocator release its zeroed pages, empty slabs, and
+   cached thread pages, which can free blocks that were not free
+   at the start.  Also checks that allocations of a number of
+   pages that is not a power of 2 can be freed in full. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define BIG_BLOCK 16            /* Pages in a "large" block. */
+#define MAX_PAGES 4096          /* Most pages we can track. */
+
+static size_t count_big_blocks (void);
+
+void
+test_palloc_buddy (void)
+{
+  static void *pages[MAX_PAGES];
+  size_t before, after;
+  size_t page_cnt, i;
+  void *a, *b;
+
+  before = count_big_blocks ();
+  if (before == 0)
+    fail ("no free %d-page blocks to start with", BIG_BLOCK);
+
+  /* Odd-sized allocations must not overlap. */
+  a = palloc_get_multiple (PAL_ZERO, 3);
+  b = palloc_get_multiple (PAL_ZERO, 5);
+  if (a == NULL || b == NULL)
+    fail ("odd-sized allocation failed");
+  if ((uint8_t *) a + 3 * PGSIZE > (uint8_t *) b
+      && (uint8_t *) b + 5 * PGSIZE > (uint8_t *) a)
+    fail ("3-page and 5-page blocks overlap");
+  memset (a, 0x5a, 3 * PGSIZE);
+  palloc_free_multiple (a, 3);
+  palloc_free_multiple (b, 5);
+  msg ("Allocated and freed 3-page and 5-page blocks.");
+
+  /* Take every page. */
+  for (page_cnt = 0; page_cnt < MAX_PAGES; page_cnt++)
+    {
+      pages[page_cnt] = palloc_get_page (0);
+      if (pages[page_cnt] == NULL)
+        break;
+    }
+  if (page_cnt == MAX_PAGES)
+    fail ("kernel pool has more than %d pages", MAX_PAGES);
+  msg ("Kernel pool exhausted.");
+
+  /* Free the even-numbered pages, then the odd-numbered ones, so
+     that most frees find their buddy still in use. */
+  for (i = 0; i < page_cnt; i += 2)
+    palloc_free_page (pages[i]);
+  for (i = 1; i < page_cnt; i += 2)
+    palloc_free_page (pages[i]);
+
+  after = count_big_blocks ();
+  if (after < before)
+    fail ("%zu %d-page blocks before, only %zu after",
+          before, BIG_BLOCK, after);
+  msg ("Freed pages merged back into %d-page blocks.", BIG_BLOCK);
+  pass ();
+}
+
+/* Returns the number of BIG_BLOCK-page blocks that can be
+   allocated from the kernel pool at once, freeing them again
+   before returning. */
+static size_t
+count_big_blocks (void)
+{
+  static void *blocks[MAX_PAGES / BIG_BLOCK];
+  size_t cnt, i;
+
+  for (cnt = 0; cnt < sizeof blocks / sizeof *blocks; cnt++)
+    {
+      blocks[cnt] = palloc_get_multiple (0, BIG_BLOCK);
+      if (blocks[cnt] == NULL)
+        break;
+    }
+  for (i = 0; i < cnt; i++)
+    palloc_free_multiple (blocks[i], BIG_BLOCK);
+  return cnt;
+}
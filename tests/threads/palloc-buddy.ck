@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) Allocated and freed 3-page and 5-page blocks.
+(palloc-buddy) Kernel pool exhausted.
+(palloc-buddy) Freed pages merged back into 16-page blocks.
+(palloc-buddy) PASS
+(palloc-buddy) end
+EOF
+pass;
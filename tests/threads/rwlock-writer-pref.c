@@ -0,0 +1,72 @@
+/* Checks that a waiting writer holds off later readers of a
+   readers-writer lock, and that upgrading a read hold works.
+
+   The main thread holds the lock for reading.  A writer arrives
+   and must wait; then a higher-priority reader arrives, and must
+   wait behind the writer rather than joining the main thread.
+   When the main thread releases its read hold, the writer should
+   get the lock before the reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread;
+static thread_func reader_thread;
+
+void
+test_rwlock_writer_pref (void)
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_acquire_read (&rwlock);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, &rwlock);
+  msg ("Writer should be waiting.");
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread, &rwlock);
+  msg ("Reader should be waiting behind the writer.");
+  if (rwlock_try_acquire_read (&rwlock))
+    fail ("Got a second read hold with a writer waiting.");
+  msg ("Main thread releasing read hold.");
+  rwlock_release_read (&rwlock);
+
+  rwlock_acquire_read (&rwlock);
+  if (!rwlock_try_upgrade (&rwlock))
+    fail ("Upgrade failed with no one else waiting.");
+  if (!rwlock_held_for_write (&rwlock))
+    fail ("Not held for write after upgrade.");
+  msg ("Upgraded read hold to write hold.");
+  rwlock_downgrade (&rwlock);
+  rwlock_release_read (&rwlock);
+  msg ("Main thread finished.");
+}
+
+static void
+writer_thread (void *rwlock_)
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_write (rwlock);
+  msg ("Writer got the lock.");
+  rwlock_release_write (rwlock);
+  msg ("Writer done.");
+}
+
+static void
+reader_thread (void *rwlock_)
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_read (rwlock);
+  msg ("Reader got the lock.");
+  rwlock_release_read (rwlock);
+  msg ("Reader done.");
+}
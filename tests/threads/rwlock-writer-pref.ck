@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-pref) begin
+(rwlock-writer-pref) Writer should be waiting.
+(rwlock-writer-pref) Reader should be waiting behind the writer.
+(rwlock-writer-pref) Main thread releasing read hold.
+(rwlock-writer-pref) Writer got the lock.
+(rwlock-writer-pref) Reader got the lock.
+(rwlock-writer-pref) Reader done.
+(rwlock-writer-pref) Writer done.
+(rwlock-writer-pref) Upgraded read hold to write hold.
+(rwlock-writer-pref) Main thread finished.
+(rwlock-writer-pref) end
+EOF
+pass;
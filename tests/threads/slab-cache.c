@@ -0,0 +1,77 @@
+/* Allocates several slabs' worth of objects from an object
+   cache with a constructor, checks that the objects are distinct,
+   constructed, and do not overlap, then frees them all and
+   checks that the empty slabs can be reclaimed. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+
+/* An object whose size is just over a power of 2. */
+struct test_obj
+  {
+    unsigned magic;
+    char payload[540 - sizeof (unsigned)];
+  };
+
+#define TEST_MAGIC 0x0b7ec7ed
+
+static kmem_ctor_func test_ctor;
+static size_t ctor_cnt;
+
+void
+test_slab_cache (void)
+{
+  static struct kmem_cache cache;
+  static struct test_obj *objs[64];
+  size_t obj_cnt;
+  size_t i, j;
+
+  kmem_cache_create (&cache, "test", sizeof (struct test_obj), test_ctor);
+  obj_cnt = cache.objs_per_slab * 3 + 1;
+  ASSERT (obj_cnt <= sizeof objs / sizeof *objs);
+  msg ("Packing %zu-byte objects %zu to a page.",
+       sizeof (struct test_obj), cache.objs_per_slab);
+
+  for (i = 0; i < obj_cnt; i++)
+    {
+      objs[i] = kmem_cache_alloc (&cache);
+      if (objs[i] == NULL)
+        fail ("allocation %zu failed", i);
+      if (objs[i]->magic != TEST_MAGIC)
+        fail ("object %zu was not constructed", i);
+      memset (objs[i]->payload, i, sizeof objs[i]->payload);
+    }
+  if (ctor_cnt != cache.objs_per_slab * 4)
+    fail ("constructor ran %zu times for 4 slabs", ctor_cnt);
+
+  for (i = 0; i < obj_cnt; i++)
+    for (j = 0; j < sizeof objs[i]->payload; j++)
+      if (objs[i]->payload[j] != (char) i)
+        fail ("object %zu overlaps another object", i);
+  msg ("%zu objects allocated without overlap.", obj_cnt);
+
+  for (i = 0; i < obj_cnt; i++)
+    kmem_cache_free (&cache, objs[i]);
+  if (kmem_reclaim () == 0)
+    fail ("no empty slabs to reclaim");
+  msg ("Freed all objects and reclaimed empty slabs.");
+
+  /* Objects from a fresh slab are constructed again. */
+  objs[0] = kmem_cache_alloc (&cache);
+  if (objs[0] == NULL || objs[0]->magic != TEST_MAGIC)
+    fail ("object from new slab was not constructed");
+  kmem_cache_free (&cache, objs[0]);
+  pass ();
+}
+
+static void
+test_ctor (void *obj_)
+{
+  struct test_obj *obj = obj_;
+
+  obj->magic = TEST_MAGIC;
+  ctor_cnt++;
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Packing 540-byte objects 7 to a page.
+(slab-cache) 22 objects allocated without overlap.
+(slab-cache) Freed all objects and reclaimed empty slabs.
+(slab-cache) PASS
+(slab-cache) end
+EOF
+pass;
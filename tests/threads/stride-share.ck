@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::mlfqs;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (@actual, @tickets);
+local ($_);
+foreach (@output) {
+    my ($id, $t, $count)
+      = /Thread (\d+) with (\d+) tickets received (\d+) ticks\./ or next;
+    ($tickets[$id], $actual[$id]) = ($t, $count);
+}
+fail "Missing tick counts.\n" if @actual != 3 || grep (!defined, @actual);
+
+# Each thread's expected share of the ticks actually handed out
+# is proportional to its tickets.
+my ($total_ticks) = 0;
+my ($total_tickets) = 0;
+$total_ticks += $_ foreach @actual;
+$total_tickets += $_ foreach @tickets;
+my (@expected) = map ($total_ticks * $_ / $total_tickets, @tickets);
+
+mlfqs_compare ("thread", "%.0f", \@actual, \@expected, 40, [0, 2, 1],
+	       "Some tick counts differed from their share of the CPU "
+	       . "by more than 40.");
+pass;
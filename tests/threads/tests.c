@@ -39,6 +39,15 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"stride-share", test_stride_share},
+    {"thread-create-bench", test_thread_create_bench},
+    {"workqueue-order", test_workqueue_order},
+    {"rwlock-writer-pref", test_rwlock_writer_pref},
+    {"slab-cache", test_slab_cache},
+    {"malloc-bench", test_malloc_bench},
+    {"palloc-buddy", test_palloc_buddy},
+    {"bitmap-bench", test_bitmap_bench},
+    {"malloc-realloc", test_malloc_realloc},
   };
 
 static const char *test_name;
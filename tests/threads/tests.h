@@ -33,6 +33,15 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_stride_share;
+extern test_func test_thread_create_bench;
+extern test_func test_workqueue_order;
+extern test_func test_rwlock_writer_pref;
+extern test_func test_slab_cache;
+extern test_func test_malloc_bench;
+extern test_func test_palloc_buddy;
+extern test_func test_bitmap_bench;
+extern test_func test_malloc_realloc;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
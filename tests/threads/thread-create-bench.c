@@ -0,0 +1,54 @@
+/* Creates and joins a large number of short-lived threads, one
+   batch at a time, and reports how long it took.  Exercises the
+   thread page cache: after the first batch, every new thread
+   should be able to reuse the page of one that has exited. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define BATCH_CNT 100           /* Number of batches. */
+#define BATCH_SIZE 5            /* Threads per batch. */
+
+static thread_func short_thread;
+
+void
+test_thread_create_bench (void)
+{
+  struct semaphore done;
+  int64_t start;
+  int created = 0;
+  int i, j;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  start = timer_ticks ();
+  for (i = 0; i < BATCH_CNT; i++)
+    {
+      for (j = 0; j < BATCH_SIZE; j++)
+        {
+          tid_t tid = thread_create ("short", PRI_DEFAULT,
+                                     short_thread, &done);
+          if (tid == TID_ERROR)
+            fail ("thread_create() failed after %d threads", created);
+          created++;
+        }
+      for (j = 0; j < BATCH_SIZE; j++)
+        sema_down (&done);
+    }
+  msg ("Created and joined %d threads in %"PRId64" ticks.",
+       created, timer_elapsed (start));
+}
+
+static void
+short_thread (void *done_)
+{
+  struct semaphore *done = done_;
+  sema_up (done);
+}
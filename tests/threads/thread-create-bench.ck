@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# The tick count varies from run to run, so only its presence
+# is checked.
+fail "Wrong output:\n" . join ('', map ("$_\n", @output))
+  if @output != 3
+     || $output[0] ne '(thread-create-bench) begin'
+     || $output[1] !~ /^\(thread-create-bench\) Created and joined 500 threads in \d+ ticks\.$/
+     || $output[2] ne '(thread-create-bench) end';
+pass;
@@ -0,0 +1,87 @@
+/* Queues work items on a work queue, some right away and some
+   after a delay, and checks that each runs exactly once and that
+   delayed items run in order of their deadlines. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define IMMEDIATE_CNT 20
+#define DELAYED_CNT 5
+
+struct test_work
+  {
+    struct work work;
+    int id;
+    int run_cnt;
+  };
+
+static struct test_work immediate[IMMEDIATE_CNT];
+static struct test_work delayed[DELAYED_CNT];
+static int order[DELAYED_CNT];
+static int order_cnt;
+
+static work_func immediate_func;
+static work_func delayed_func;
+
+void
+test_workqueue_order (void)
+{
+  /* Delays, in ticks, of the delayed items.  They run in
+     ascending order of delay: 2, 3, 0, 4, 1. */
+  static const int delays[DELAYED_CNT] = {30, 50, 10, 20, 40};
+  struct workqueue wq;
+  int i;
+
+  workqueue_create (&wq, "test");
+
+  for (i = 0; i < DELAYED_CNT; i++)
+    {
+      delayed[i].id = i;
+      work_init (&delayed[i].work, delayed_func);
+      if (!queue_delayed_work (&wq, &delayed[i].work, delays[i]))
+        fail ("could not queue delayed item %d", i);
+    }
+  if (queue_delayed_work (&wq, &delayed[0].work, 1))
+    fail ("delayed item queued twice");
+
+  for (i = 0; i < IMMEDIATE_CNT; i++)
+    {
+      immediate[i].id = i;
+      work_init (&immediate[i].work, immediate_func);
+      if (!queue_work (&wq, &immediate[i].work))
+        fail ("could not queue item %d", i);
+    }
+  flush_workqueue (&wq);
+  for (i = 0; i < IMMEDIATE_CNT; i++)
+    if (immediate[i].run_cnt != 1)
+      fail ("item %d ran %d times", i, immediate[i].run_cnt);
+  msg ("%d immediate items ran once each.", IMMEDIATE_CNT);
+
+  timer_sleep (60);
+  flush_workqueue (&wq);
+  for (i = 0; i < order_cnt; i++)
+    msg ("Delayed item %d ran.", order[i]);
+}
+
+static void
+immediate_func (struct work *w)
+{
+  struct test_work *tw = (struct test_work *) w;
+  enum intr_level old_level = intr_disable ();
+  tw->run_cnt++;
+  intr_set_level (old_level);
+}
+
+static void
+delayed_func (struct work *w)
+{
+  struct test_work *tw = (struct test_work *) w;
+  enum intr_level old_level = intr_disable ();
+  order[order_cnt++] = tw->id;
+  intr_set_level (old_level);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue-order) begin
+(workqueue-order) 20 immediate items ran once each.
+(workqueue-order) Delayed item 2 ran.
+(workqueue-order) Delayed item 3 ran.
+(workqueue-order) Delayed item 0 ran.
+(workqueue-order) Delayed item 4 ran.
+(workqueue-order) Delayed item 1 ran.
+(workqueue-order) end
+EOF
+pass;
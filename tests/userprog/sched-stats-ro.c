@@ -0,0 +1,16 @@
+/* Passes a pointer into the read-only code segment to the
+   schedstats system call, which must cause the process to be
+   terminated with exit code -1 rather than let the kernel write
+   there. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  msg ("schedstats(%p): %d", (void *) test_main,
+       schedstats ((struct sched_stats *) test_main));
+  fail ("should have exited with -1");
+}
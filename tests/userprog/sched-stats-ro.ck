@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-stats-ro) begin
+sched-stats-ro: exit(-1)
+EOF
+pass;
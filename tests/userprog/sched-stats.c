@@ -0,0 +1,24 @@
+/* Tests the schedstats system call. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  struct sched_stats st;
+  uint32_t wakeups = 0;
+  int i;
+
+  CHECK (schedstats (&st), "schedstats");
+  if (st.run_cycles == 0)
+    fail ("no running time recorded");
+  for (i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+    wakeups += st.latency_hist[i];
+
+  /* At the least, this process's thread was woken up once, when
+     it was created. */
+  if (wakeups == 0)
+    fail ("no wakeups recorded");
+}
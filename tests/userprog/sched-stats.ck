@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-stats) begin
+(sched-stats) schedstats
+(sched-stats) end
+sched-stats: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Executes and waits for a series of child processes, one at a
+   time, and reports how long this process spent blocked per
+   child, which covers loading, running and reaping it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SPAWN_CNT 20
+
+void
+test_main (void)
+{
+  struct sched_stats before, after;
+  int i;
+
+  schedstats (&before);
+  for (i = 0; i < SPAWN_CNT; i++)
+    if (wait (exec ("child-simple")) != 81)
+      fail ("child %d did not exit normally", i);
+  schedstats (&after);
+
+  msg ("%d spawns, %llu cycles blocked per spawn.", SPAWN_CNT,
+       (after.blocked_cycles - before.blocked_cycles) / SPAWN_CNT);
+}
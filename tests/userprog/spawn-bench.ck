@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# The cycle count varies from run to run, so only its presence
+# is checked.
+my (@expected) = ('(spawn-bench) begin');
+push (@expected, '(child-simple) run', 'child-simple: exit(81)')
+  foreach 1...20;
+fail "Wrong output:\n" . join ('', map ("$_\n", @output))
+  if @output != @expected + 3
+     || grep ($output[$_] ne $expected[$_], 0...$#expected)
+     || $output[-3] !~ /^\(spawn-bench\) 20 spawns, \d+ cycles blocked per spawn\.$/
+     || $output[-2] ne '(spawn-bench) end'
+     || $output[-1] ne 'spawn-bench: exit(0)';
+pass;
@@ -0,0 +1,38 @@
+/* Touches a few scattered pages of a large initialized array and
+   a large zero-initialized array, each of which is loaded only
+   when first accessed, and checks that they read back with the
+   contents from the executable or all zeros. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (64 * PAGE_SIZE)
+
+static char data[SIZE] = {[0] = 'a', [SIZE / 2 + 1] = 'b', [SIZE - 1] = 'c'};
+static char bss[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read initialized data");
+  if (data[0] != 'a' || data[SIZE / 2 + 1] != 'b' || data[SIZE - 1] != 'c')
+    fail ("initialized bytes read back wrong");
+  for (i = PAGE_SIZE; i < SIZE; i += 7 * PAGE_SIZE)
+    if (data[i] != 0)
+      fail ("data byte %zu is %d, not 0", i, data[i]);
+
+  msg ("read and write zero-filled data");
+  for (i = 3; i < SIZE; i += 5 * PAGE_SIZE)
+    {
+      if (bss[i] != 0)
+        fail ("bss byte %zu is %d, not 0", i, bss[i]);
+      bss[i] = 'z';
+    }
+  for (i = 3; i < SIZE; i += 5 * PAGE_SIZE)
+    if (bss[i] != 'z')
+      fail ("bss byte %zu did not keep its value", i);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-lazy) begin
+(page-lazy) read initialized data
+(page-lazy) read and write zero-filled data
+(page-lazy) end
+EOF
+pass;
@@ -47,6 +47,22 @@ static unsigned int unexpected_cnt[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Softirqs.  Bit N of softirq_pending is set when softirq N has
+   been raised and its function has not yet run.  Pending
+   softirqs run at the end of the outermost external interrupt,
+   after the PIC is acknowledged, with interrupts enabled.  An
+   external interrupt that arrives while softirqs are running
+   nests as usual, but leaves any softirqs it raises, and any
+   yield it requests, to the outer invocation. */
+static softirq_func *softirq_handlers[SOFTIRQ_CNT];
+static unsigned softirq_pending;
+static bool in_softirq;         /* Are we running softirqs? */
+
+/* Maximum number of times softirq_run() rescans softirq_pending
+   before leaving the rest for the next interrupt, so that a
+   flood of interrupts cannot starve the interrupted thread. */
+#define SOFTIRQ_MAX_ROUNDS 4
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -59,6 +75,7 @@ static inline uint64_t make_idtr_operand (uint16_t limit, void *base);
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
 static void unexpected_interrupt (const struct intr_frame *);
+static void softirq_run (void);
 
 /* Returns the current interrupt status. */
 enum intr_level
@@ -88,7 +105,7 @@ enum intr_level
 intr_enable (void)
 {
   enum intr_level old_level = intr_get_level ();
-  ASSERT (!intr_context ());
+  ASSERT (!in_external_intr);
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -206,18 +223,18 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
   register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt or
+   of the softirqs it raised, and false at all other times. */
 bool
 intr_context (void)
 {
-  return in_external_intr;
+  return in_external_intr || in_softirq;
 }
 
-/* During processing of an external interrupt, directs the
-   interrupt handler to yield to a new process just before
-   returning from the interrupt.  May not be called at any other
-   time. */
+/* During processing of an external interrupt or a softirq,
+   directs the interrupt handler to yield to a new process just
+   before returning from the interrupt.  May not be called at any
+   other time. */
 void
 intr_yield_on_return (void)
 {
@@ -225,6 +242,59 @@ intr_yield_on_return (void)
   yield_on_return = true;
 }
 
+/* Registers FUNC as the function to run for softirq NR. */
+void
+softirq_register (enum softirq nr, softirq_func *func)
+{
+  ASSERT (nr < SOFTIRQ_CNT);
+  ASSERT (softirq_handlers[nr] == NULL);
+
+  softirq_handlers[nr] = func;
+}
+
+/* Marks softirq NR pending, so that its function runs at the
+   end of the current external interrupt, or of the next one if
+   called outside interrupt context. */
+void
+softirq_raise (enum softirq nr)
+{
+  enum intr_level old_level;
+
+  ASSERT (nr < SOFTIRQ_CNT);
+
+  old_level = intr_disable ();
+  softirq_pending |= 1u << nr;
+  intr_set_level (old_level);
+}
+
+/* Runs pending softirqs with interrupts enabled.  Called with
+   interrupts off at the end of an external interrupt, and
+   returns with them off. */
+static void
+softirq_run (void)
+{
+  int round;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!in_external_intr && !in_softirq);
+
+  in_softirq = true;
+  for (round = 0; softirq_pending != 0 && round < SOFTIRQ_MAX_ROUNDS;
+       round++)
+    {
+      unsigned pending = softirq_pending;
+      int nr;
+
+      softirq_pending = 0;
+      intr_enable ();
+      for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+        if ((pending & (1u << nr)) && softirq_handlers[nr] != NULL)
+          softirq_handlers[nr] ();
+      intr_disable ();
+    }
+  in_softirq = false;
+}
+
 /* 8259A Programmable Interrupt Controller. */
 
 /* Initializes the PICs.  Refer to [8259A] for details.
@@ -350,15 +420,21 @@ intr_handler (struct intr_frame *frame)
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
      and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
+     An external interrupt handler cannot sleep.  One may nest
+     inside softirq processing, though, in which case the yield
+     flag belongs to the outer interrupt. */
   external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
   if (external)
     {
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (!intr_context ());
+      ASSERT (!in_external_intr);
 
       in_external_intr = true;
-      yield_on_return = false;
+      if (!in_softirq)
+        yield_on_return = false;
+
+      /* Catch up on any ticks skipped while idle. */
+      timer_idle_exit (frame->vec_no);
     }
 
   /* Invoke the interrupt's handler. */
@@ -383,8 +459,13 @@ intr_handler (struct intr_frame *frame)
       in_external_intr = false;
       pic_end_of_interrupt (frame->vec_no);
 
-      if (yield_on_return)
-        thread_yield ();
+      if (!in_softirq)
+        {
+          if (softirq_pending != 0)
+            softirq_run ();
+          if (yield_on_return)
+            thread_yield ();
+        }
     }
 }
 
@@ -64,6 +64,23 @@ void intr_register_int (uint8_t vec, int dpl, enum intr_level,
 bool intr_context (void);
 void intr_yield_on_return (void);
 
+/* Deferred interrupt work ("softirqs").  An external interrupt
+   handler does only what must be done with interrupts off, then
+   raises a softirq; the softirq's function runs once the handler
+   returns and the PIC has been acknowledged, with interrupts
+   back on.  Softirq functions run in interrupt context and so
+   may not sleep. */
+enum softirq
+  {
+    SOFTIRQ_TIMER,              /* Timer tick bookkeeping. */
+    SOFTIRQ_BLOCK,              /* Block device completions. */
+    SOFTIRQ_CNT                 /* Number of softirqs. */
+  };
+
+typedef void softirq_func (void);
+void softirq_register (enum softirq, softirq_func *);
+void softirq_raise (enum softirq);
+
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
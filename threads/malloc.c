@@ -5,40 +5,67 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/loader.h"
+#include "threads/memstat.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   The size of each request, in bytes, is rounded up to the
+   nearest size class and assigned to the "descriptor" that
+   manages blocks of that size.  The classes are the powers of 2
+   from 16 bytes to 1 kB, plus 1.5 kB, 3 kB, and 6 kB.  The
+   descriptor keeps a list of free blocks.  If the free list is
+   nonempty, one of its blocks is used to satisfy the request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
+   malloc() returns a null pointer).  Classes above 1 kB use
+   arenas of several contiguous pages instead, so that little of
+   the arena is left over.  The new arena is divided into blocks,
+   all of which are added to the descriptor's free list.  Then we
+   return one of the new blocks.
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   A block in a one-page arena finds its arena header at the
+   start of its page.  Blocks in multi-page arenas may start on
+   any page of the arena, so arena_map records the arena that
+   each such page belongs to.
+
+   We handle blocks bigger than 6 kB, and those just under a page
+   that one page holds more cheaply than a 6 kB block, by
+   allocating contiguous pages with the page allocator and
+   sticking the allocation size at the beginning of the allocated
+   block's arena header.  realloc() resizes these "big blocks" in
+   place when the pages after them are free, and any block whose
+   new size keeps it in the same size class.
+
+   Taking a descriptor's lock on every malloc() and free() is
+   costly even without contention, so each thread also keeps a
+   "magazine" of free blocks for each descriptor, a short stack
+   linked through the blocks themselves.  malloc() and free()
+   push and pop the calling thread's magazine without locking.
+   Only when the magazine is empty, or holds more than its
+   descriptor's mag_size blocks, is the lock taken, to move a
+   batch of mag_batch blocks from or to the free list.  Blocks in
+   a magazine count as in use as far as their arena is concerned,
+   so a thread returns its magazines' blocks when it exits. */
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
+    size_t arena_pages;         /* Number of pages in an arena. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t mag_size;            /* Blocks per thread's magazine. */
+    size_t mag_batch;           /* Blocks moved per refill or drain. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
   };
@@ -58,38 +85,119 @@ struct arena
 struct block
   {
     struct list_elem free_elem; /* Free list element. */
+    struct block *mag_next;     /* Next block in a magazine. */
+  };
+
+/* Bytes of each size class a magazine may hold. */
+#define MAGAZINE_BYTES 512
+
+/* Most blocks a magazine may hold. */
+#define MAGAZINE_MAX 16
+
+/* Size classes above 1 kB, and the pages in each one's arenas.
+   Each arena loses less than a third of a block to rounding. */
+static const struct
+  {
+    size_t block_size;
+    size_t arena_pages;
+  }
+large_classes[] =
+  {
+    {1536, 2},                  /* 5 blocks per arena. */
+    {3072, 4},                  /* 5 blocks per arena. */
+    {6144, 8},                  /* 5 blocks per arena. */
   };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[MALLOC_CLASS_CNT];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Arena that each page of RAM belongs to, indexed by physical
+   page number, or a null pointer if the page is not part of a
+   multi-page arena. */
+static struct arena **arena_map;
+
+static void init_desc (size_t block_size, size_t arena_pages);
+static void *get_block (size_t size);
+static void free_block (void *);
+static struct desc *size_to_desc (size_t size);
+static bool resize_in_place (void *block, size_t new_size);
+static void map_arena (struct arena *, struct arena *owner);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static bool magazine_refill (struct desc *, struct magazine *);
+static void magazine_drain (struct desc *, struct magazine *, size_t cnt);
+static void release_block (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void)
 {
+  size_t map_pages = DIV_ROUND_UP (init_ram_pages * sizeof *arena_map,
+                                   PGSIZE);
   size_t block_size;
+  size_t i;
 
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
-    {
-      struct desc *d = &descs[desc_cnt++];
-      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-      d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-      list_init (&d->free_list);
-      lock_init (&d->lock);
-    }
+    init_desc (block_size, 1);
+  for (i = 0; i < sizeof large_classes / sizeof *large_classes; i++)
+    init_desc (large_classes[i].block_size, large_classes[i].arena_pages);
+  ASSERT (desc_cnt == MALLOC_CLASS_CNT);
+
+  arena_map = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, map_pages);
+}
+
+/* Initializes the next descriptor, for blocks of BLOCK_SIZE
+   bytes carved from arenas of ARENA_PAGES pages. */
+static void
+init_desc (size_t block_size, size_t arena_pages)
+{
+  struct desc *d = &descs[desc_cnt++];
+
+  ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+  d->block_size = block_size;
+  d->arena_pages = arena_pages;
+  d->blocks_per_arena = ((PGSIZE * arena_pages - sizeof (struct arena))
+                         / block_size);
+  d->mag_size = MAGAZINE_BYTES / block_size;
+  if (d->mag_size > MAGAZINE_MAX)
+    d->mag_size = MAGAZINE_MAX;
+  d->mag_batch = d->mag_size > 1 ? d->mag_size / 2 : 1;
+  list_init (&d->free_list);
+  lock_init (&d->lock);
+}
+
+/* Returns the blocks in the running thread's magazines to their
+   descriptors.  Called by thread_exit() once the thread will make
+   no more calls to malloc() or free(), since blocks that reach
+   its magazines afterward would never be returned. */
+void
+malloc_thread_exit (void)
+{
+  struct magazine *mags = thread_current ()->magazines;
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    if (mags[i].cnt > 0)
+      magazine_drain (&descs[i], &mags[i], mags[i].cnt);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size)
+{
+  void *p = get_block (size);
+  memstat_alloc (MEMSTAT_MALLOC, p, size, MEMSTAT_CALLER ());
+  return p;
+}
+
+/* Allocates a block for malloc(), which see. */
+static void *
+get_block (size_t size)
 {
   struct desc *d;
+  struct magazine *mag;
   struct block *b;
   struct arena *a;
 
@@ -97,14 +205,10 @@ malloc (size_t size)
   if (size == 0)
     return NULL;
 
-  /* Find the smallest descriptor that satisfies a SIZE-byte
-     request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt)
+  d = size_to_desc (size);
+  if (d == NULL)
     {
-      /* SIZE is too big for any descriptor.
+      /* SIZE is a big block.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
@@ -119,37 +223,14 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
-    {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL)
-        {
-          lock_release (&d->lock);
-          return NULL;
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++)
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
-    }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
+  /* Take a block from this thread's magazine for D, refilling it
+     from D's free list if it is empty. */
+  mag = &thread_current ()->magazines[d - descs];
+  if (mag->cnt == 0 && !magazine_refill (d, mag))
+    return NULL;
+  b = mag->top;
+  mag->top = b->mag_next;
+  mag->cnt--;
   return b;
 }
 
@@ -167,13 +248,31 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = get_block (size);
+  memstat_alloc (MEMSTAT_MALLOC, p, size, MEMSTAT_CALLER ());
   if (p != NULL)
     memset (p, 0, size);
 
   return p;
 }
 
+/* Returns the descriptor for a SIZE-byte request, or a null
+   pointer if it should be a big block.  That is the smallest
+   descriptor whose blocks are large enough, unless a big block
+   would take no more memory than that descriptor's share of an
+   arena, as for requests just under a page. */
+static struct desc *
+size_to_desc (size_t size)
+{
+  size_t page_cnt = DIV_ROUND_UP (size + sizeof (struct arena), PGSIZE);
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      return page_cnt * d->blocks_per_arena > d->arena_pages ? d : NULL;
+  return NULL;
+}
+
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block)
@@ -199,24 +298,68 @@ realloc (void *old_block, size_t new_size)
       free (old_block);
       return NULL;
     }
+  else if (old_block != NULL && resize_in_place (old_block, new_size))
+    {
+      memstat_resize (MEMSTAT_MALLOC, old_block, new_size);
+      return old_block;
+    }
   else
     {
-      void *new_block = malloc (new_size);
+      void *new_block = get_block (new_size);
+      memstat_alloc (MEMSTAT_MALLOC, new_block, new_size, MEMSTAT_CALLER ());
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
           size_t min_size = new_size < old_size ? new_size : old_size;
           memcpy (new_block, old_block, min_size);
-          free (old_block);
+          memstat_free (MEMSTAT_MALLOC, old_block);
+          free_block (old_block);
         }
       return new_block;
     }
 }
 
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   A block of a descriptor can stay put only if NEW_SIZE maps to
+   the same descriptor.  A big block can stay put if NEW_SIZE
+   still calls for a big block, by freeing pages from its end or
+   by allocating the free pages that follow it.  Returns true if
+   successful. */
+static bool
+resize_in_place (void *block, size_t new_size)
+{
+  struct arena *a = block_to_arena (block);
+  size_t new_cnt;
+
+  if (a->desc != NULL || size_to_desc (new_size) != NULL)
+    return size_to_desc (new_size) == a->desc;
+
+  new_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+  if (new_cnt < a->free_cnt)
+    {
+      palloc_free_multiple ((uint8_t *) a + PGSIZE * new_cnt,
+                            a->free_cnt - new_cnt);
+      memstat_resize (MEMSTAT_PALLOC, a, new_cnt);
+    }
+  else if (new_cnt > a->free_cnt
+           && !palloc_extend (a, a->free_cnt, new_cnt))
+    return false;
+  a->free_cnt = new_cnt;
+  return true;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
 free (void *p)
+{
+  memstat_free (MEMSTAT_MALLOC, p);
+  free_block (p);
+}
+
+/* Frees block P for free() and realloc(). */
+static void
+free_block (void *p)
 {
   if (p != NULL)
     {
@@ -227,32 +370,20 @@ free (void *p)
       if (d != NULL)
         {
           /* It's a normal block.  We handle it here. */
+          struct magazine *mag = &thread_current ()->magazines[d - descs];
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
 
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena)
-            {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++)
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
-            }
-
-          lock_release (&d->lock);
+          /* Put the block in this thread's magazine for D,
+             draining a batch back to D's free list if that
+             leaves the magazine overfull. */
+          b->mag_next = mag->top;
+          mag->top = b;
+          if (++mag->cnt > d->mag_size)
+            magazine_drain (d, mag, d->mag_batch);
         }
       else
         {
@@ -263,11 +394,123 @@ free (void *p)
     }
 }
 
+/* Moves up to D's mag_batch blocks from D's free list into MAG,
+   first creating a new arena if the free list is empty.  Returns
+   false if no block could be obtained. */
+static bool
+magazine_refill (struct desc *d, struct magazine *mag)
+{
+  size_t cnt;
+
+  lock_acquire (&d->lock);
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      struct arena *a;
+      size_t i;
+
+      /* Allocate pages. */
+      a = palloc_get_multiple (0, d->arena_pages);
+      if (a == NULL)
+        {
+          lock_release (&d->lock);
+          return false;
+        }
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      map_arena (a, a);
+      for (i = 0; i < d->blocks_per_arena; i++)
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+    }
+
+  /* Move blocks from the free list to the magazine. */
+  for (cnt = 0; cnt < d->mag_batch && !list_empty (&d->free_list); cnt++)
+    {
+      struct block *b = list_entry (list_pop_front (&d->free_list),
+                                    struct block, free_elem);
+      block_to_arena (b)->free_cnt--;
+      b->mag_next = mag->top;
+      mag->top = b;
+      mag->cnt++;
+    }
+
+  lock_release (&d->lock);
+  return true;
+}
+
+/* Moves CNT blocks from MAG back to D's free list. */
+static void
+magazine_drain (struct desc *d, struct magazine *mag, size_t cnt)
+{
+  ASSERT (cnt <= mag->cnt);
+
+  lock_acquire (&d->lock);
+  while (cnt-- > 0)
+    {
+      struct block *b = mag->top;
+      mag->top = b->mag_next;
+      mag->cnt--;
+      release_block (d, b);
+    }
+  lock_release (&d->lock);
+}
+
+/* Adds B to D's free list, and frees B's arena if that leaves
+   all of its blocks free.  D's lock must be held. */
+static void
+release_block (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena)
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++)
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      map_arena (a, NULL);
+      palloc_free_multiple (a, d->arena_pages);
+    }
+}
+
+/* Sets the arena_map entries for the pages of A, if A spans
+   more than one page, to OWNER. */
+static void
+map_arena (struct arena *a, struct arena *owner)
+{
+  size_t first = pg_no ((void *) vtop (a));
+  size_t i;
+
+  if (a->desc->arena_pages > 1)
+    for (i = 0; i < a->desc->arena_pages; i++)
+      arena_map[first + i] = owner;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
 {
-  struct arena *a = pg_round_down (b);
+  struct arena *a = arena_map[pg_no ((void *) vtop (b))];
+
+  if (a == NULL)
+    a = pg_round_down (b);
 
   /* Check that the arena is valid. */
   ASSERT (a != NULL);
@@ -275,7 +518,7 @@ block_to_arena (struct block *b)
 
   /* Check that the block is properly aligned for the arena. */
   ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+          || ((uint8_t *) b - (uint8_t *) (a + 1)) % a->desc->block_size == 0);
   ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
   return a;
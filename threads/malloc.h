@@ -4,7 +4,20 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Number of size classes: 16 bytes up to 1 kB by powers of 2,
+   then 1.5 kB, 3 kB, and 6 kB. */
+#define MALLOC_CLASS_CNT 10
+
+/* A thread's private cache of free blocks of one size class.
+   See malloc.c. */
+struct magazine
+  {
+    struct block *top;          /* Most recently cached block. */
+    size_t cnt;                 /* Number of blocks cached. */
+  };
+
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
@@ -0,0 +1,276 @@
+#include "threads/memstat.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+
+#ifdef MEM_STATS
+/* Call sites are kept in a fixed-size hash table for each kind
+   of allocator, with linear probing.  Live allocations are kept
+   in another, keyed by address, so that freeing a block can
+   credit the site that it was charged to.  Nothing is ever
+   allocated for the tables themselves, and each hook costs a
+   hash probe or two with interrupts off, so the accounting can
+   be left on under load.  An allocation that finds a table full
+   is counted as untracked instead of being recorded. */
+
+/* Call sites per kind of allocator.  Must be a power of 2. */
+#define SITE_BITS 8
+#define SITE_CNT (1 << SITE_BITS)
+
+/* Live allocations, of all kinds.  Must be a power of 2.  At
+   most 3/4 of the slots are used, to keep probe chains short. */
+#define LIVE_BITS 13
+#define LIVE_CNT (1 << LIVE_BITS)
+#define LIVE_MAX (LIVE_CNT / 4 * 3)
+
+/* Number of sites printed for each kind of allocator. */
+#define TOP_CNT 10
+
+/* A call site. */
+struct site
+  {
+    void *caller;               /* Return address, null if unused. */
+    size_t allocs;              /* Allocations ever charged. */
+    size_t live_cnt;            /* Allocations not yet freed. */
+    size_t live_size;           /* Bytes or pages not yet freed. */
+    size_t peak_size;           /* Largest value of live_size. */
+  };
+
+/* A live allocation. */
+struct live
+  {
+    void *block;                /* Allocated block, null if unused. */
+    size_t size;                /* Bytes or pages. */
+    uint16_t site;              /* Index of site charged. */
+    uint8_t kind;               /* A "enum memstat_kind". */
+  };
+
+/* Names and units of each kind, for printing. */
+static const char *kind_names[MEMSTAT_KIND_CNT] = {"malloc", "palloc"};
+static const char *kind_units[MEMSTAT_KIND_CNT] = {"bytes", "pages"};
+
+/* Tables.  Protected by disabling interrupts. */
+static struct site sites[MEMSTAT_KIND_CNT][SITE_CNT];
+static struct live lives[LIVE_CNT];
+static size_t live_cnt;         /* Slots in use in LIVES. */
+static size_t untracked[MEMSTAT_KIND_CNT]; /* Allocations not recorded. */
+
+static unsigned hash_ptr (const void *, int bits);
+static struct site *find_site (enum memstat_kind, void *caller);
+static struct live *find_live (enum memstat_kind, void *block);
+static void remove_live (struct live *);
+static void print_kind (enum memstat_kind);
+
+/* Charges the SIZE bytes or pages at BLOCK, just allocated by a
+   function called from CALLER, to that call site.  Does nothing
+   if BLOCK is null. */
+void
+memstat_alloc (enum memstat_kind kind, void *block, size_t size,
+               void *caller)
+{
+  enum intr_level old_level;
+  struct site *s;
+
+  if (block == NULL)
+    return;
+
+  old_level = intr_disable ();
+  s = find_site (kind, caller);
+  if (s != NULL && live_cnt < LIVE_MAX)
+    {
+      struct live *l = &lives[hash_ptr (block, LIVE_BITS)];
+
+      while (l->block != NULL)
+        if (++l == lives + LIVE_CNT)
+          l = lives;
+      l->block = block;
+      l->size = size;
+      l->site = s - sites[kind];
+      l->kind = kind;
+      live_cnt++;
+
+      s->allocs++;
+      s->live_cnt++;
+      s->live_size += size;
+      if (s->live_size > s->peak_size)
+        s->peak_size = s->live_size;
+    }
+  else
+    untracked[kind]++;
+  intr_set_level (old_level);
+}
+
+/* Records that BLOCK, if it is being tracked, has been resized
+   in place to SIZE bytes or pages. */
+void
+memstat_resize (enum memstat_kind kind, void *block, size_t size)
+{
+  enum intr_level old_level = intr_disable ();
+  struct live *l = find_live (kind, block);
+
+  if (l != NULL)
+    {
+      struct site *s = &sites[kind][l->site];
+
+      s->live_size += size - l->size;
+      if (s->live_size > s->peak_size)
+        s->peak_size = s->live_size;
+      l->size = size;
+    }
+  intr_set_level (old_level);
+}
+
+/* Credits BLOCK, which is being freed, back to the site that it
+   was charged to.  Does nothing if BLOCK is not being tracked. */
+void
+memstat_free (enum memstat_kind kind, void *block)
+{
+  enum intr_level old_level = intr_disable ();
+  struct live *l = find_live (kind, block);
+
+  if (l != NULL)
+    {
+      struct site *s = &sites[kind][l->site];
+
+      s->live_cnt--;
+      s->live_size -= l->size;
+      remove_live (l);
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints the call sites holding the most memory for each kind of
+   allocator, followed by the pages in use in each pool.  Sites
+   are printed as return addresses, which "backtrace kernel.o"
+   translates to source lines.  The tables are read without
+   turning interrupts off, so the numbers may be slightly
+   inconsistent if allocations are made meanwhile. */
+void
+memstat_print_stats (void)
+{
+  int kind;
+
+  for (kind = 0; kind < MEMSTAT_KIND_CNT; kind++)
+    print_kind (kind);
+  palloc_print_stats ();
+}
+
+/* Prints the TOP_CNT sites of KIND with the most memory live. */
+static void
+print_kind (enum memstat_kind kind)
+{
+  const struct site *top[TOP_CNT];
+  size_t top_cnt = 0;
+  size_t blocks = 0, size = 0;
+  const struct site *s;
+  size_t i;
+
+  for (s = sites[kind]; s < sites[kind] + SITE_CNT; s++)
+    if (s->caller != NULL)
+      {
+        blocks += s->live_cnt;
+        size += s->live_size;
+
+        /* Insert S into TOP, which is sorted by live size. */
+        for (i = top_cnt; i > 0 && top[i - 1]->live_size < s->live_size; i--)
+          if (i < TOP_CNT)
+            top[i] = top[i - 1];
+        if (i < TOP_CNT)
+          {
+            top[i] = s;
+            if (top_cnt < TOP_CNT)
+              top_cnt++;
+          }
+      }
+
+  printf ("Memory: %s: %zu %s live in %zu allocations, %zu untracked\n",
+          kind_names[kind], size, kind_units[kind], blocks,
+          untracked[kind]);
+  for (i = 0; i < top_cnt && top[i]->live_size > 0; i++)
+    printf ("  %p: %10zu %s live in %6zu, peak %10zu, %8zu allocations\n",
+            top[i]->caller, top[i]->live_size, kind_units[kind],
+            top[i]->live_cnt, top[i]->peak_size, top[i]->allocs);
+}
+
+/* Returns a hash of P in the range 0...2**BITS - 1. */
+static unsigned
+hash_ptr (const void *p, int bits)
+{
+  return ((uintptr_t) p * 2654435761u) >> (32 - bits);
+}
+
+/* Returns the site of KIND for CALLER, adding one if there is
+   none yet.  Returns a null pointer if the table is full.
+   Interrupts must be off. */
+static struct site *
+find_site (enum memstat_kind kind, void *caller)
+{
+  struct site *table = sites[kind];
+  unsigned idx = hash_ptr (caller, SITE_BITS);
+  size_t probes;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (probes = 0; probes < SITE_CNT; probes++)
+    {
+      struct site *s = &table[idx];
+
+      if (s->caller == caller)
+        return s;
+      else if (s->caller == NULL)
+        {
+          s->caller = caller;
+          return s;
+        }
+      idx = (idx + 1) & (SITE_CNT - 1);
+    }
+  return NULL;
+}
+
+/* Returns the live allocation of KIND at BLOCK, or a null
+   pointer if there is none.  Interrupts must be off. */
+static struct live *
+find_live (enum memstat_kind kind, void *block)
+{
+  unsigned idx = hash_ptr (block, LIVE_BITS);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (; lives[idx].block != NULL; idx = (idx + 1) & (LIVE_CNT - 1))
+    if (lives[idx].block == block && lives[idx].kind == kind)
+      return &lives[idx];
+  return NULL;
+}
+
+/* Removes L from the live allocations, moving later entries in
+   its probe chain back so that lookups never stop short.
+   Interrupts must be off. */
+static void
+remove_live (struct live *l)
+{
+  unsigned hole = l - lives;
+  unsigned idx = hole;
+
+  for (;;)
+    {
+      unsigned home;
+
+      idx = (idx + 1) & (LIVE_CNT - 1);
+      if (lives[idx].block == NULL)
+        break;
+
+      /* The entry at IDX may fill the hole unless its home slot
+         lies cyclically after the hole. */
+      home = hash_ptr (lives[idx].block, LIVE_BITS);
+      if (((idx - home) & (LIVE_CNT - 1)) >= ((idx - hole) & (LIVE_CNT - 1)))
+        {
+          lives[hole] = lives[idx];
+          hole = idx;
+        }
+    }
+  lives[hole].block = NULL;
+  live_cnt--;
+}
+#endif /* MEM_STATS */
@@ -0,0 +1,46 @@
+#ifndef THREADS_MEMSTAT_H
+#define THREADS_MEMSTAT_H
+
+#include <stddef.h>
+
+/* Kernel memory accounting.
+
+   When the kernel is built with "make MEM_STATS=1", every
+   allocation through malloc(), calloc(), realloc(), and
+   palloc_get_page() or palloc_get_multiple() is charged to its
+   call site, the return address of the call into the allocator,
+   and credited back when it is freed.  memstat_print_stats()
+   prints the call sites holding the most memory, and the number
+   of pages in use in each pool.  It runs at shutdown, and before
+   the kernel panics for lack of pages.  It may also be called
+   at any other time, for example from a test.
+
+   Otherwise, the hooks compile to nothing. */
+
+/* Allocators accounted separately. */
+enum memstat_kind
+  {
+    MEMSTAT_MALLOC,             /* malloc() and friends, in bytes. */
+    MEMSTAT_PALLOC,             /* Page allocator, in pages. */
+    MEMSTAT_KIND_CNT            /* Number of kinds. */
+  };
+
+#ifdef MEM_STATS
+/* The return address of the calling function, for use as the
+   CALLER argument to memstat_alloc(). */
+#define MEMSTAT_CALLER() __builtin_return_address (0)
+
+void memstat_alloc (enum memstat_kind, void *block, size_t size,
+                    void *caller);
+void memstat_resize (enum memstat_kind, void *block, size_t size);
+void memstat_free (enum memstat_kind, void *block);
+void memstat_print_stats (void);
+#else
+#define MEMSTAT_CALLER() NULL
+#define memstat_alloc(KIND, BLOCK, SIZE, CALLER) ((void) 0)
+#define memstat_resize(KIND, BLOCK, SIZE) ((void) 0)
+#define memstat_free(KIND, BLOCK) ((void) 0)
+#define memstat_print_stats() ((void) 0)
+#endif
+
+#endif /* threads/memstat.h */
@@ -1,14 +1,17 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
+#include <list.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/memstat.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -25,12 +28,64 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
+/* Each pool is managed by a binary buddy allocator.  Its free
+   pages are grouped into blocks of 2**ORDER pages, for ORDER
+   from 0 up to BUDDY_ORDERS - 1, each aligned on a multiple of
+   its own size relative to the pool's base.  There is a free
+   list for each order, linked through the first page of each
+   free block, so finding a block of a given size takes at most
+   BUDDY_ORDERS steps, and a single page usually takes just one.
+
+   A larger block is split in halves ("buddies") as needed to
+   satisfy a request for a smaller one.  When a block is freed
+   and its buddy is also free, the two are merged back into a
+   block of the next order up, repeatedly.  A request for a
+   number of pages that is not a power of 2 takes a block of the
+   next power of 2 and immediately frees the unneeded tail, so
+   callers may free any whole number of pages that they were
+   given, as before.
+
+   Each pool also keeps a short list of free pages that are
+   already filled with zeros, so that single-page PAL_ZERO
+   requests, such as for thread stacks and page tables, need not
+   clear a page on the caller's time.  The idle thread tops the
+   list up to the pool's zeroed_target by calling
+   palloc_zero_idle().  Pages on the list are allocated as far as
+   the buddy allocator is concerned, so they are handed back to
+   it whenever an allocation would otherwise fail.
+
+   The pools are accessed with interrupts off rather than under
+   a lock, because thread pages are freed from inside the
+   scheduler. */
+
+/* Number of block orders.  The largest block is 2**15 pages, or
+   128 MB. */
+#define BUDDY_ORDERS 16
+
+/* Per-page state, in a pool's page_info array. */
+#define PAGE_USED 0x00                  /* Allocated. */
+#define PAGE_FREE_TAIL 0x40             /* Free, not first in block. */
+#define PAGE_FREE 0x80                  /* Heads block; OR'd with order. */
+
+/* Most pages a pool keeps zeroed, and the largest share of the
+   pool they may take, as a divisor. */
+#define ZEROED_MAX 16
+#define ZEROED_SHARE 32
+
+/* Returned by alloc_block() on failure. */
+#define PAGE_IDX_ERROR SIZE_MAX
+
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    const char *name;                   /* Name, for debugging. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages. */
+    uint8_t *page_info;                 /* State of each page. */
+    struct list free_lists[BUDDY_ORDERS]; /* Free blocks by order. */
+    struct list zeroed;                 /* Free pages filled with zeros. */
+    size_t zeroed_cnt;                  /* Number of pages in ZEROED. */
+    size_t zeroed_target;               /* Pages idle thread keeps zeroed. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,7 +93,19 @@ static struct pool kernel_pool, user_pool;
 
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
+static void *get_pages (enum palloc_flags, size_t page_cnt);
+static void print_pool_stats (struct pool *);
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *page_pool (void *page);
+static void *get_zeroed_page (struct pool *);
+static bool release_zeroed (struct pool *);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static size_t alloc_block (struct pool *, int order);
+static void claim_page (struct pool *, size_t page_idx);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void free_block (struct pool *, size_t page_idx, int order);
+static struct list_elem *page_elem (const struct pool *, size_t page_idx);
+static size_t elem_page (const struct pool *, struct list_elem *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -69,19 +136,50 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  void *pages = get_pages (flags, page_cnt);
+  memstat_alloc (MEMSTAT_PALLOC, pages, page_cnt, MEMSTAT_CALLER ());
+  return pages;
+}
+
+/* Allocates pages for palloc_get_multiple(), which see. */
+static void *
+get_pages (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  /* Take a page that is already zeroed, if one is wanted. */
+  if (page_cnt == 1 && (flags & PAL_ZERO))
+    {
+      pages = get_zeroed_page (pool);
+      if (pages != NULL)
+        return pages;
+    }
+
+  old_level = intr_disable ();
+  page_idx = alloc_pages (pool, page_cnt);
+  if (page_idx == PAGE_IDX_ERROR && release_zeroed (pool))
+    page_idx = alloc_pages (pool, page_cnt);
+  intr_set_level (old_level);
+
+  /* If the kernel pool is exhausted, take back the empty slabs
+     cached by the object allocator and the pages cached for new
+     threads, and try again. */
+  if (page_idx == PAGE_IDX_ERROR && pool == &kernel_pool
+      && kmem_reclaim () + thread_page_reclaim () > 0)
+    {
+      old_level = intr_disable ();
+      page_idx = alloc_pages (pool, page_cnt);
+      intr_set_level (old_level);
+    }
 
-  if (page_idx != BITMAP_ERROR)
+  if (page_idx != PAGE_IDX_ERROR)
     pages = pool->base + PGSIZE * page_idx;
   else
     pages = NULL;
@@ -94,7 +192,10 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   else
     {
       if (flags & PAL_ASSERT)
-        PANIC ("palloc_get: out of pages");
+        {
+          memstat_print_stats ();
+          PANIC ("palloc_get: out of pages");
+        }
     }
 
   return pages;
@@ -110,7 +211,9 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags)
 {
-  return palloc_get_multiple (flags, 1);
+  void *page = get_pages (flags, 1);
+  memstat_alloc (MEMSTAT_PALLOC, page, 1, MEMSTAT_CALLER ());
+  return page;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -118,27 +221,98 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
+  memstat_free (MEMSTAT_PALLOC, pages);
+  pool = page_pool (pages);
   page_idx = pg_no (pages) - pg_no (pool->base);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  free_range (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
+}
+
+/* Tries to grow the PAGE_CNT pages starting at PAGES, which
+   must have been obtained from palloc_get_multiple(), to
+   NEW_CNT pages without moving them, by allocating the pages
+   that follow them.  Returns true if successful, false if any of
+   those pages is in use or outside the pool.  The new pages are
+   not zeroed. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t new_cnt)
+{
+  struct pool *pool;
+  enum intr_level old_level;
+  size_t page_idx, i;
+  bool success = true;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_cnt >= page_cnt);
+
+  pool = page_pool (pages);
+  page_idx = pg_no (pages) - pg_no (pool->base);
+  if (new_cnt > pool->page_cnt - page_idx)
+    return false;
+
+  old_level = intr_disable ();
+  for (i = page_idx + page_cnt; i < page_idx + new_cnt; i++)
+    if (pool->page_info[i] == PAGE_USED)
+      {
+        success = false;
+        break;
+      }
+  if (success)
+    for (i = page_idx + page_cnt; i < page_idx + new_cnt; i++)
+      claim_page (pool, i);
+  intr_set_level (old_level);
+
+  if (success)
+    memstat_resize (MEMSTAT_PALLOC, pages, new_cnt);
+  return success;
+}
+
+/* Called by the idle thread, with interrupts off.  If a pool has
+   fewer zeroed pages than its target, zeroes one more, with
+   interrupts turned on meanwhile, and returns true.  Returns
+   false if there was nothing to do. */
+bool
+palloc_zero_idle (void)
+{
+  struct pool *pool;
+  size_t page_idx;
+  void *page;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (kernel_pool.zeroed_cnt < kernel_pool.zeroed_target)
+    pool = &kernel_pool;
+  else if (user_pool.zeroed_cnt < user_pool.zeroed_target)
+    pool = &user_pool;
+  else
+    return false;
+
+  /* Don't bother if the pool is out of pages. */
+  page_idx = alloc_pages (pool, 1);
+  if (page_idx == PAGE_IDX_ERROR)
+    return false;
+  page = pool->base + PGSIZE * page_idx;
+
+  intr_enable ();
+  memset (page, 0, PGSIZE);
+  intr_disable ();
+
+  list_push_front (&pool->zeroed, page);
+  pool->zeroed_cnt++;
+  return true;
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +322,73 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Prints the number of pages used and free in each pool. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool);
+  print_pool_stats (&user_pool);
+}
+
+/* Prints statistics for POOL. */
+static void
+print_pool_stats (struct pool *pool)
+{
+  enum intr_level old_level;
+  size_t free_cnt = 0, largest = 0, zeroed_cnt;
+  int order;
+
+  old_level = intr_disable ();
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    {
+      size_t blocks = list_size (&pool->free_lists[order]);
+
+      free_cnt += blocks << order;
+      if (blocks > 0)
+        largest = (size_t) 1 << order;
+    }
+  zeroed_cnt = pool->zeroed_cnt;
+  intr_set_level (old_level);
+
+  printf ("Memory: %s: %zu of %zu pages used, %zu free "
+          "(largest block %zu), %zu zeroed\n",
+          pool->name, pool->page_cnt - free_cnt - zeroed_cnt,
+          pool->page_cnt, free_cnt, largest, zeroed_cnt);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's page_info at its base.
+     Calculate the space needed for it
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t info_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+
+  if (info_pages > page_cnt)
+    PANIC ("Not enough memory in %s for page info.", name);
+  page_cnt -= info_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  /* Initialize the pool, with every page in use, then free
+     them all. */
+  p->name = name;
+  p->base = (uint8_t *) base + info_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->page_info = base;
+  memset (p->page_info, PAGE_USED, page_cnt);
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    list_init (&p->free_lists[order]);
+  free_range (p, 0, page_cnt);
+
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->zeroed_target = page_cnt / ZEROED_SHARE;
+  if (p->zeroed_target > ZEROED_MAX)
+    p->zeroed_target = ZEROED_MAX;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +398,226 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the pool that PAGE belongs to. */
+static struct pool *
+page_pool (void *page)
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  else
+    NOT_REACHED ();
+}
+
+/* Removes a page from POOL's list of zeroed pages and returns
+   it, or returns a null pointer if the list is empty. */
+static void *
+get_zeroed_page (struct pool *pool)
+{
+  enum intr_level old_level;
+  struct list_elem *e = NULL;
+
+  old_level = intr_disable ();
+  if (!list_empty (&pool->zeroed))
+    {
+      e = list_pop_front (&pool->zeroed);
+      pool->zeroed_cnt--;
+    }
+  intr_set_level (old_level);
+
+  /* The list element was the only nonzero part of the page. */
+  if (e != NULL)
+    memset (e, 0, sizeof *e);
+  return e;
+}
+
+/* Gives all of POOL's zeroed pages back to the buddy allocator.
+   Returns true if there were any.  Interrupts must be off. */
+static bool
+release_zeroed (struct pool *pool)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (&pool->zeroed))
+    return false;
+  while (!list_empty (&pool->zeroed))
+    free_block (pool, elem_page (pool, list_pop_front (&pool->zeroed)), 0);
+  pool->zeroed_cnt = 0;
+  return true;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or PAGE_IDX_ERROR if no large enough block
+   is free.  Interrupts must be off. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt)
+{
+  size_t page_idx;
+  int order;
+
+  /* Round PAGE_CNT up to a power of 2. */
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    if (((size_t) 1 << order) >= page_cnt)
+      break;
+  if (order >= BUDDY_ORDERS)
+    return PAGE_IDX_ERROR;
+
+  /* Take a block of that size and give back what is left over. */
+  page_idx = alloc_block (pool, order);
+  if (page_idx != PAGE_IDX_ERROR && ((size_t) 1 << order) > page_cnt)
+    free_range (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  return page_idx;
+}
+
+/* Marks free page PAGE_IDX in POOL used, splitting the free
+   block that contains it and freeing the rest of that block as
+   smaller blocks.  Interrupts must be off. */
+static void
+claim_page (struct pool *pool, size_t page_idx)
+{
+  size_t block_idx;
+  int order;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (pool->page_info[page_idx] != PAGE_USED);
+
+  /* Find the head of the free block that contains PAGE_IDX. */
+  for (order = 0; ; order++)
+    {
+      ASSERT (order < BUDDY_ORDERS);
+      block_idx = page_idx & ~(((size_t) 1 << order) - 1);
+      if (pool->page_info[block_idx] == (PAGE_FREE | order))
+        break;
+    }
+  list_remove (page_elem (pool, block_idx));
+  pool->page_info[block_idx] = PAGE_FREE_TAIL;
+
+  /* Halve the block until it is just PAGE_IDX, freeing the half
+     that does not contain PAGE_IDX each time. */
+  while (order > 0)
+    {
+      size_t half = (size_t) 1 << --order;
+      size_t other = page_idx & half ? block_idx : block_idx + half;
+
+      if (page_idx & half)
+        block_idx += half;
+      pool->page_info[other] = PAGE_FREE | order;
+      list_push_front (&pool->free_lists[order], page_elem (pool, other));
+    }
+
+  pool->page_info[page_idx] = PAGE_USED;
+}
+
+/* Removes a free block of 2**ORDER pages from POOL, splitting a
+   larger block if necessary, and marks its pages used.  Returns
+   the index of its first page, or PAGE_IDX_ERROR if no block is
+   large enough.  Interrupts must be off. */
+static size_t
+alloc_block (struct pool *pool, int order)
+{
+  size_t page_idx;
+  int o;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (o = order; o < BUDDY_ORDERS; o++)
+    if (!list_empty (&pool->free_lists[o]))
+      break;
+  if (o >= BUDDY_ORDERS)
+    return PAGE_IDX_ERROR;
+
+  page_idx = elem_page (pool, list_pop_front (&pool->free_lists[o]));
+  ASSERT (pool->page_info[page_idx] == (PAGE_FREE | o));
+
+  /* Split the block, freeing the upper half each time, until it
+     is the requested size. */
+  while (o > order)
+    {
+      size_t buddy;
+
+      o--;
+      buddy = page_idx + ((size_t) 1 << o);
+      pool->page_info[buddy] = PAGE_FREE | o;
+      list_push_front (&pool->free_lists[o], page_elem (pool, buddy));
+    }
+
+  memset (pool->page_info + page_idx, PAGE_USED, (size_t) 1 << order);
+  return page_idx;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+   largest aligned blocks that they can be divided into.
+   Interrupts must be off. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order + 1 < BUDDY_ORDERS
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Frees the block of 2**ORDER pages starting at PAGE_IDX in
+   POOL, merging it with its buddy for as long as the buddy is
+   also free.  Interrupts must be off. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (page_idx % ((size_t) 1 << order) == 0);
+
+  for (i = 0; i < ((size_t) 1 << order); i++)
+    {
+      ASSERT (pool->page_info[page_idx + i] == PAGE_USED);
+      pool->page_info[page_idx + i] = PAGE_FREE_TAIL;
+    }
+
+  while (order + 1 < BUDDY_ORDERS)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->page_info[buddy] != (PAGE_FREE | order))
+        break;
+
+      list_remove (page_elem (pool, buddy));
+      pool->page_info[buddy] = PAGE_FREE_TAIL;
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+    }
+
+  pool->page_info[page_idx] = PAGE_FREE | order;
+  list_push_front (&pool->free_lists[order], page_elem (pool, page_idx));
+}
+
+/* Returns the free list element stored in page PAGE_IDX of
+   POOL. */
+static struct list_elem *
+page_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the index of the page in POOL that holds E. */
+static size_t
+elem_page (const struct pool *pool, struct list_elem *e)
+{
+  return ((uint8_t *) e - pool->base) / PGSIZE;
+}
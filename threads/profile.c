@@ -0,0 +1,142 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Sampling kernel profiler.
+
+   When enabled, the timer interrupt handler calls
+   profile_sample() on every tick.  Every PROFILE_INTERVAL ticks,
+   it records the interrupted instruction pointer, plus a short
+   backtrace obtained by following the chain of saved frame
+   pointers on the interrupted thread's kernel stack, into a ring
+   buffer allocated at boot.  Once the ring buffer fills up, new
+   samples replace the oldest ones.
+
+   At shutdown, profile_dump() prints each sample as a line of
+   the form
+       PROF k 0xc0021234 0xc0020f5e ...
+   for a sample taken in kernel mode (innermost frame first), or
+       PROF u 0x080481ab
+   for one taken in user mode.  Run "backtrace --folded" on the
+   output to turn it into folded stacks for a flame graph. */
+
+/* Enabled by "-profile" option. */
+bool profile_enabled;
+
+/* Take a sample every this many timer ticks.  Set by
+   "-profile=N" option. */
+int profile_interval = 1;
+
+/* Maximum number of return addresses in a sample, including the
+   interrupted instruction pointer. */
+#define PROFILE_DEPTH 8
+
+/* Pages of memory to use for the ring buffer. */
+#define PROFILE_PAGES 16
+
+/* One sample. */
+struct sample
+  {
+    uint8_t depth;              /* Number of entries in PC[]. */
+    bool user;                  /* Taken in user mode? */
+    uintptr_t pc[PROFILE_DEPTH]; /* Innermost first. */
+  };
+
+static struct sample *samples;  /* Ring buffer. */
+static size_t sample_cap;       /* Capacity of ring buffer. */
+static size_t sample_next;      /* Index of next slot to fill. */
+static long long sample_total;  /* Number of samples ever taken. */
+static int ticks_to_sample;     /* Ticks until next sample. */
+
+/* Allocates the ring buffer, if profiling is enabled.  Must be
+   called after the page allocator is initialized. */
+void
+profile_init (void)
+{
+  if (!profile_enabled)
+    return;
+
+  if (profile_interval < 1)
+    profile_interval = 1;
+  samples = palloc_get_multiple (PAL_ZERO, PROFILE_PAGES);
+  if (samples == NULL)
+    {
+      printf ("profile: cannot allocate sample buffer, profiling disabled\n");
+      profile_enabled = false;
+      return;
+    }
+  sample_cap = PROFILE_PAGES * PGSIZE / sizeof *samples;
+  ticks_to_sample = profile_interval;
+}
+
+/* Records a sample of the code interrupted by F, if one is due.
+   Called from the timer interrupt handler. */
+void
+profile_sample (const struct intr_frame *f)
+{
+  struct sample *s;
+
+  if (!profile_enabled || --ticks_to_sample > 0)
+    return;
+  ticks_to_sample = profile_interval;
+
+  s = &samples[sample_next];
+  if (++sample_next >= sample_cap)
+    sample_next = 0;
+  sample_total++;
+
+  s->pc[0] = (uintptr_t) f->eip;
+  s->depth = 1;
+  s->user = (f->cs & 3) == 3;
+  if (!s->user)
+    {
+      /* Follow the saved frame pointers, but only while they stay
+         within the kernel stack page that F is on and keep moving
+         toward its top, so that a frame pointer register being
+         used for something else cannot lead us astray. */
+      uintptr_t stack_top = (uintptr_t) pg_round_down (f) + PGSIZE;
+      uintptr_t fp = f->ebp;
+
+      while (s->depth < PROFILE_DEPTH
+             && fp > (uintptr_t) f && fp % sizeof (uint32_t) == 0
+             && fp + 2 * sizeof (uint32_t) <= stack_top)
+        {
+          const uint32_t *frame = (const uint32_t *) fp;
+          if (frame[1] == 0)
+            break;
+          s->pc[s->depth++] = frame[1];
+          if (frame[0] <= fp)
+            break;
+          fp = frame[0];
+        }
+    }
+}
+
+/* Prints the recorded samples, oldest first. */
+void
+profile_dump (void)
+{
+  size_t cnt, start, i;
+
+  if (!profile_enabled)
+    return;
+
+  cnt = sample_total < (long long) sample_cap ? sample_total : sample_cap;
+  start = sample_total < (long long) sample_cap ? 0 : sample_next;
+  printf ("Profile: %lld samples taken every %d tick(s), %zu recorded\n",
+          sample_total, profile_interval, cnt);
+  for (i = 0; i < cnt; i++)
+    {
+      const struct sample *s = &samples[(start + i) % sample_cap];
+      int j;
+
+      printf ("PROF %c", s->user ? 'u' : 'k');
+      for (j = 0; j < s->depth; j++)
+        printf (" %#"PRIxPTR, s->pc[j]);
+      printf ("\n");
+    }
+}
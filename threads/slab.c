@@ -0,0 +1,278 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator for fixed-size kernel objects.
+
+   malloc() rounds every request up to a power of 2, which
+   wastes close to half the memory for objects just over a power
+   of 2 in size.  A kmem_cache instead holds objects of exactly
+   one size, packed back to back into "slabs".  Each slab is a
+   page obtained from the page allocator, with a struct slab
+   header at its start followed by as many objects as fit.
+
+   The free objects in a slab are chained through a link word.
+   For a cache without a constructor, the link overlays the
+   start of the free object itself.  A cache with a constructor
+   keeps its objects constructed while they are free, so its
+   link is placed just past the end of each object instead.
+
+   Each cache sorts its slabs into three lists: partial slabs,
+   which are allocated from first; full slabs; and empty slabs.
+   Up to SLAB_EMPTY_MAX empty slabs are kept on hand so that a
+   cache whose usage hovers around a slab boundary does not
+   repeatedly construct and free a slab.  When the page
+   allocator runs out of kernel pages, it calls kmem_reclaim()
+   to return every empty slab to it. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab0b1e
+
+/* Objects are aligned to this many bytes, which is enough for
+   any type under the i386 ABI. */
+#define KMEM_ALIGN 4
+
+/* Maximum number of empty slabs a cache keeps. */
+#define SLAB_EMPTY_MAX 2
+
+/* Slab header, at the start of each slab page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of cache's lists. */
+    size_t in_use;              /* Number of allocated objects. */
+    void *free;                 /* First free object, or null. */
+  };
+
+/* Offset of the first object in a slab. */
+#define SLAB_HEADER_SIZE ROUND_UP (sizeof (struct slab), KMEM_ALIGN)
+
+/* All caches.  Caches are never destroyed, so the list only
+   grows.  Insertions are made with interrupts off, which lets
+   kmem_reclaim() walk it without a lock. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *slab_create (struct kmem_cache *);
+static void **obj_link (const struct kmem_cache *, void *obj);
+
+/* Initializes CACHE to hand out objects of SIZE bytes, naming
+   it NAME for debugging purposes.  If CTOR is nonnull, it is
+   used to construct each object when its slab is created. */
+void
+kmem_cache_create (struct kmem_cache *cache, const char *name, size_t size,
+                   kmem_ctor_func *ctor)
+{
+  enum intr_level old_level;
+  size_t stride;
+
+  ASSERT (cache != NULL);
+  ASSERT (size > 0);
+
+  cache->name = name;
+  cache->obj_size = size;
+  cache->ctor = ctor;
+  if (ctor != NULL)
+    {
+      cache->link_ofs = ROUND_UP (size, sizeof (void *));
+      stride = cache->link_ofs + sizeof (void *);
+    }
+  else
+    {
+      cache->link_ofs = 0;
+      stride = size > sizeof (void *) ? size : sizeof (void *);
+    }
+  cache->stride = ROUND_UP (stride, KMEM_ALIGN);
+  cache->objs_per_slab = (PGSIZE - SLAB_HEADER_SIZE) / cache->stride;
+  ASSERT (cache->objs_per_slab > 0);
+
+  lock_init (&cache->lock);
+  list_init (&cache->partial);
+  list_init (&cache->full);
+  list_init (&cache->empty);
+  cache->empty_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &cache->elem);
+  intr_set_level (old_level);
+}
+
+/* Allocates and returns an object from CACHE, or a null pointer
+   if no memory is available.  The object is in the state its
+   constructor left it in, or uninitialized if CACHE has no
+   constructor. */
+void *
+kmem_cache_alloc (struct kmem_cache *cache)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&cache->lock);
+  if (list_empty (&cache->partial) && list_empty (&cache->empty))
+    {
+      /* Grow the cache.  Drop the lock meanwhile, so that the
+         page allocator can reclaim empty slabs from any cache,
+         this one included, if it is short of pages. */
+      lock_release (&cache->lock);
+      s = slab_create (cache);
+      if (s == NULL)
+        return NULL;
+      lock_acquire (&cache->lock);
+      list_push_back (&cache->empty, &s->elem);
+      cache->empty_cnt++;
+    }
+
+  /* Prefer a partial slab, so that empty slabs stay empty. */
+  if (!list_empty (&cache->partial))
+    s = list_entry (list_front (&cache->partial), struct slab, elem);
+  else
+    {
+      s = list_entry (list_pop_front (&cache->empty), struct slab, elem);
+      cache->empty_cnt--;
+      list_push_front (&cache->partial, &s->elem);
+    }
+
+  obj = s->free;
+  s->free = *obj_link (cache, obj);
+  if (++s->in_use == cache->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_back (&cache->full, &s->elem);
+    }
+  lock_release (&cache->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from CACHE, to
+   CACHE.  If OBJ is a null pointer, does nothing. */
+void
+kmem_cache_free (struct kmem_cache *cache, void *obj)
+{
+  struct slab *s;
+  bool was_full;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == cache);
+  ASSERT (((uint8_t *) obj - ((uint8_t *) s + SLAB_HEADER_SIZE))
+          % cache->stride == 0);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it must keep its constructed state. */
+  if (cache->ctor == NULL)
+    memset (obj, 0xcc, cache->obj_size);
+#endif
+
+  lock_acquire (&cache->lock);
+  ASSERT (s->in_use > 0);
+  *obj_link (cache, obj) = s->free;
+  s->free = obj;
+  was_full = s->in_use-- == cache->objs_per_slab;
+
+  if (s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (cache->empty_cnt >= SLAB_EMPTY_MAX)
+        {
+          lock_release (&cache->lock);
+          s->magic = 0;
+          palloc_free_page (s);
+          return;
+        }
+      list_push_front (&cache->empty, &s->elem);
+      cache->empty_cnt++;
+    }
+  else if (was_full)
+    {
+      list_remove (&s->elem);
+      list_push_front (&cache->partial, &s->elem);
+    }
+  lock_release (&cache->lock);
+}
+
+/* Returns every empty slab in every cache to the page
+   allocator.  Returns the number of pages freed.  Must not be
+   called with any cache's lock held. */
+size_t
+kmem_reclaim (void)
+{
+  struct list_elem *e;
+  size_t freed = 0;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *cache = list_entry (e, struct kmem_cache, elem);
+      struct list victims;
+
+      /* Unlink the empty slabs under the lock, free them after. */
+      list_init (&victims);
+      lock_acquire (&cache->lock);
+      while (!list_empty (&cache->empty))
+        list_push_back (&victims, list_pop_front (&cache->empty));
+      cache->empty_cnt = 0;
+      lock_release (&cache->lock);
+
+      while (!list_empty (&victims))
+        {
+          struct slab *s = list_entry (list_pop_front (&victims),
+                                       struct slab, elem);
+          s->magic = 0;
+          palloc_free_page (s);
+          freed++;
+        }
+    }
+  return freed;
+}
+
+/* Obtains a page from the page allocator and sets it up as an
+   empty slab for CACHE, constructing each of its objects.
+   Returns the new slab, or a null pointer if no page is
+   available. */
+static struct slab *
+slab_create (struct kmem_cache *cache)
+{
+  struct slab *s;
+  uint8_t *obj;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = cache;
+  s->in_use = 0;
+  s->free = NULL;
+
+  /* Chain the objects in address order, last to first. */
+  obj = ((uint8_t *) s + SLAB_HEADER_SIZE
+         + cache->objs_per_slab * cache->stride);
+  for (i = 0; i < cache->objs_per_slab; i++)
+    {
+      obj -= cache->stride;
+      if (cache->ctor != NULL)
+        cache->ctor (obj);
+      *obj_link (cache, obj) = s->free;
+      s->free = obj;
+    }
+  return s;
+}
+
+/* Returns the address of the free-list link in OBJ, a free
+   object in CACHE. */
+static void **
+obj_link (const struct kmem_cache *cache, void *obj)
+{
+  return (void **) ((uint8_t *) obj + cache->link_ofs);
+}
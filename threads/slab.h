@@ -0,0 +1,39 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Constructor for the objects of a cache.  Called once for each
+   object when the slab holding it is created, not on every
+   allocation, so objects must be freed back to the cache in
+   their constructed state. */
+typedef void kmem_ctor_func (void *obj);
+
+/* A cache of equally sized objects of one type.  See slab.c. */
+struct kmem_cache
+  {
+    const char *name;           /* Name (for debugging purposes). */
+    size_t obj_size;            /* Size of an object in bytes. */
+    size_t stride;              /* Bytes from one object to the next. */
+    size_t link_ofs;            /* Offset of free-list link in object. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+
+    struct lock lock;           /* Protects the members below. */
+    struct list partial;        /* Slabs with some objects free. */
+    struct list full;           /* Slabs with no objects free. */
+    struct list empty;          /* Slabs with every object free. */
+    size_t empty_cnt;           /* Number of slabs in EMPTY. */
+
+    struct list_elem elem;      /* Element in list of all caches. */
+  };
+
+void kmem_cache_create (struct kmem_cache *, const char *name, size_t size,
+                        kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
+size_t kmem_reclaim (void);
+
+#endif /* threads/slab.h */
@@ -27,10 +27,23 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef LOCK_STATS
+#include "devices/timer.h"
+#endif
+
+#ifdef LOCK_STATS
+/* Locks initialized with lock_init_named(), in order of
+   initialization.  Protected by disabling interrupts. */
+static struct list named_locks = LIST_INITIALIZER (named_locks);
+#endif
+
+static bool priority_more (const struct list_elem *,
+                           const struct list_elem *, void *aux);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -40,7 +53,12 @@
      decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-     thread, if any). */
+     thread, if any).
+
+   Waiting threads are kept in FIFO order.  A waiter's priority
+   can change while it sleeps, through donation, so "up" searches
+   for the highest-priority waiter when it wakes one, taking the
+   earliest of those tied for highest. */
 void
 sema_init (struct semaphore *sema, unsigned value)
 {
@@ -102,7 +120,10 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  If that thread outranks the running thread, the
+   running thread yields to it, or, within an interrupt handler,
+   yields when the handler returns.
 
    This function may be called from an interrupt handler. */
 void
@@ -114,10 +135,28 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters))
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      struct list_elem *e = list_min (&sema->waiters, priority_more, NULL);
+      list_remove (e);
+      thread_unblock (list_entry (e, struct thread, elem));
+    }
   sema->value++;
   intr_set_level (old_level);
+
+  if (!intr_context ())
+    thread_preempt ();
+}
+
+/* Returns true if thread A has a higher priority than thread
+   B. */
+static bool
+priority_more (const struct list_elem *a_, const struct list_elem *b_,
+               void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority > b->priority;
 }
 
 static void sema_test_helper (void *sema_);
@@ -157,6 +196,14 @@ sema_test_helper (void *sema_)
     }
 }
 
+/* Maximum length of a chain of nested donations.  Bounds the
+   work done by lock_acquire() even if locks form a cycle. */
+#define DONATION_DEPTH_MAX 8
+
+static void lock_take (struct lock *);
+static void donate_priority (struct lock *, int priority);
+static int lock_waiters_priority (struct lock *);
+
 /* Initializes LOCK.  A lock can be held by at most a single
    thread at any given time.  Our locks are not "recursive", that
    is, it is an error for the thread currently holding a lock to
@@ -178,7 +225,33 @@ lock_init (struct lock *lock)
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
+  lock->priority = PRI_MIN;
   sema_init (&lock->semaphore, 1);
+#ifdef LOCK_STATS
+  lock->name = NULL;
+  memset (&lock->stats, 0, sizeof lock->stats);
+#endif
+}
+
+/* Initializes LOCK like lock_init(), naming it NAME.  When the
+   kernel is built with LOCK_STATS defined, statistics for named
+   locks are printed at shutdown by lock_print_stats(), so a
+   named lock must never be destroyed.  Otherwise, NAME is
+   ignored. */
+void
+lock_init_named (struct lock *lock, const char *name)
+{
+  ASSERT (name != NULL);
+
+  lock_init (lock);
+#ifdef LOCK_STATS
+  {
+    enum intr_level old_level = intr_disable ();
+    lock->name = name;
+    list_push_back (&named_locks, &lock->stats_elem);
+    intr_set_level (old_level);
+  }
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -188,16 +261,46 @@ lock_init (struct lock *lock)
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
-   we need to sleep. */
+   we need to sleep.
+
+   While we wait, our priority is donated to the holder of LOCK
+   and, transitively, to the holder of any lock that it is
+   waiting for in turn. */
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  old_level = intr_disable ();
+  if (lock->holder != NULL)
+    {
+#ifdef LOCK_STATS
+      int64_t start = timer_ticks ();
+#endif
+      cur->waiting_lock = lock;
+      if (!thread_mlfqs)
+        donate_priority (lock, cur->priority);
+      sema_down (&lock->semaphore);
+      cur->waiting_lock = NULL;
+#ifdef LOCK_STATS
+      {
+        int64_t wait = timer_elapsed (start);
+        lock->stats.contended++;
+        lock->stats.wait_ticks += wait;
+        if (wait > lock->stats.max_wait_ticks)
+          lock->stats.max_wait_ticks = wait;
+      }
+#endif
+    }
+  else
+    sema_down (&lock->semaphore);
+  lock_take (lock);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -216,7 +319,11 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      enum intr_level old_level = intr_disable ();
+      lock_take (lock);
+      intr_set_level (old_level);
+    }
   return success;
 }
 
@@ -224,15 +331,35 @@ lock_try_acquire (struct lock *lock)
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
-   handler. */
+   handler.
+
+   Any priority donated through LOCK is given up, which may cause
+   the current thread to yield. */
 void
 lock_release (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+#ifdef LOCK_STATS
+  {
+    int64_t hold = timer_elapsed (lock->stats.acquired_at);
+    if (hold > lock->stats.max_hold_ticks)
+      lock->stats.max_hold_ticks = hold;
+  }
+#endif
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  lock->priority = PRI_MIN;
+  thread_update_priority (cur);
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
+
+  thread_preempt ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -246,13 +373,99 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+#ifdef LOCK_STATS
+/* Prints statistics for every named lock. */
+void
+lock_print_stats (void)
+{
+  struct list_elem *e;
+
+  printf ("Locks: %-12s %10s %10s %10s %8s %8s\n", "name", "acquired",
+          "contended", "wait", "max wait", "max hold");
+  for (e = list_begin (&named_locks); e != list_end (&named_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, stats_elem);
+      const struct lock_stats *st = &lock->stats;
+
+      printf ("       %-12s %10lld %10lld %10"PRId64" %8"PRId64" %8"PRId64"\n",
+              lock->name, st->acquisitions, st->contended, st->wait_ticks,
+              st->max_wait_ticks, st->max_hold_ticks);
+    }
+}
+#endif
+
+/* Makes the current thread the holder of LOCK, which it has just
+   downed, and inherits the priorities of the threads still
+   waiting for it.  Interrupts must be off. */
+static void
+lock_take (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->holder = cur;
+  lock->priority = lock_waiters_priority (lock);
+  list_push_back (&cur->held_locks, &lock->elem);
+#ifdef LOCK_STATS
+  lock->stats.acquisitions++;
+  lock->stats.acquired_at = timer_ticks ();
+#endif
+  if (!thread_mlfqs)
+    thread_update_priority (cur);
+}
+
+/* Donates PRIORITY through LOCK to its holder.  If the holder is
+   itself blocked on a lock, the donation continues down the
+   chain, up to DONATION_DEPTH_MAX locks deep.  Stops early once
+   a holder already runs at PRIORITY or higher, since everything
+   further down the chain must then do so too.  Interrupts must
+   be off. */
+static void
+donate_priority (struct lock *lock, int priority)
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; lock != NULL && depth < DONATION_DEPTH_MAX; depth++)
+    {
+      struct thread *holder = lock->holder;
+
+      if (lock->priority < priority)
+        lock->priority = priority;
+      if (holder == NULL || holder->priority >= priority)
+        break;
+      thread_update_priority (holder);
+      lock = holder->waiting_lock;
+    }
+}
+
+/* Returns the highest priority among the threads waiting for
+   LOCK, or PRI_MIN if there are none.  Interrupts must be off. */
+static int
+lock_waiters_priority (struct lock *lock)
+{
+  struct list *waiters = &lock->semaphore.waiters;
+
+  if (list_empty (waiters))
+    return PRI_MIN;
+  return list_entry (list_min (waiters, priority_more, NULL),
+                     struct thread, elem)->priority;
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Waiting thread. */
   };
 
+static bool sema_elem_priority_more (const struct list_elem *,
+                                     const struct list_elem *, void *aux);
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -280,6 +493,9 @@ cond_init (struct condition *cond)
    condition variables.  That is, there is a one-to-many mapping
    from locks to condition variables.
 
+   Waiters are signaled in order of their current priority,
+   highest first.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -295,14 +511,30 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
 
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
+/* Returns true if the thread waiting on semaphore_elem A has a
+   higher priority than the one waiting on B. */
+static bool
+sema_elem_priority_more (const struct list_elem *a_,
+                         const struct list_elem *b_, void *aux UNUSED)
+{
+  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem,
+                                               elem);
+
+  return a->thread->priority > b->thread->priority;
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
+   this function signals the highest-priority one to wake up from
+   its wait.
    LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -317,8 +549,12 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters))
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct list_elem *e = list_min (&cond->waiters,
+                                      sema_elem_priority_more, NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -336,3 +572,188 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RWLOCK.  A readers-writer lock can be held by any
+   number of readers at once, or by a single writer.
+
+   Writers are preferred: once a writer is waiting, new readers
+   wait behind it, so a steady stream of readers cannot starve
+   writers.  This works by having a writer hold WRITER_LOCK, an
+   ordinary lock, from the time it starts waiting for readers to
+   drain until it releases the rwlock, and by having each reader
+   pass through WRITER_LOCK on its way in.  Threads blocked on an
+   rwlock therefore wait on WRITER_LOCK, in priority order, and
+   donate their priority to the writer that holds or is waiting
+   for it.  Priority is not donated to readers, since there may be
+   any number of them.
+
+   A thread may not acquire an rwlock it already holds, for
+   either reading or writing. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_init (&rwlock->writer_lock);
+  lock_init (&rwlock->guard);
+  cond_init (&rwlock->no_readers);
+  rwlock->readers = 0;
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds or
+   is waiting for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+  ASSERT (!lock_held_by_current_thread (&rwlock->writer_lock));
+
+  lock_acquire (&rwlock->writer_lock);
+  lock_acquire (&rwlock->guard);
+  rwlock->readers++;
+  lock_release (&rwlock->guard);
+  lock_release (&rwlock->writer_lock);
+}
+
+/* Tries to acquire RWLOCK for reading and returns true if
+   successful or false on failure.  Fails if a writer holds or is
+   waiting for RWLOCK.  Does not sleep waiting for
+   other threads. */
+bool
+rwlock_try_acquire_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  if (!lock_try_acquire (&rwlock->writer_lock))
+    return false;
+  if (!lock_try_acquire (&rwlock->guard))
+    {
+      lock_release (&rwlock->writer_lock);
+      return false;
+    }
+  rwlock->readers++;
+  lock_release (&rwlock->guard);
+  lock_release (&rwlock->writer_lock);
+  return true;
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   reading. */
+void
+rwlock_release_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->guard);
+  ASSERT (rwlock->readers > 0);
+  if (--rwlock->readers == 0)
+    cond_signal (&rwlock->no_readers, &rwlock->guard);
+  lock_release (&rwlock->guard);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no other thread
+   holds it.  New readers are held off while this thread waits.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->writer_lock);
+  lock_acquire (&rwlock->guard);
+  while (rwlock->readers > 0)
+    cond_wait (&rwlock->no_readers, &rwlock->guard);
+  lock_release (&rwlock->guard);
+}
+
+/* Tries to acquire RWLOCK for writing and returns true if
+   successful or false on failure.  Fails if any other thread
+   holds RWLOCK.  Does not sleep waiting for
+   other threads. */
+bool
+rwlock_try_acquire_write (struct rwlock *rwlock)
+{
+  bool success = false;
+
+  ASSERT (rwlock != NULL);
+
+  if (!lock_try_acquire (&rwlock->writer_lock))
+    return false;
+  if (lock_try_acquire (&rwlock->guard))
+    {
+      success = rwlock->readers == 0;
+      lock_release (&rwlock->guard);
+    }
+  if (!success)
+    lock_release (&rwlock->writer_lock);
+  return success;
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing. */
+void
+rwlock_release_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock_held_for_write (rwlock));
+
+  lock_release (&rwlock->writer_lock);
+}
+
+/* Tries to convert the current thread's read hold on RWLOCK into
+   a write hold, waiting for any other readers to finish.
+   Returns true if successful.  Fails, leaving the read hold in
+   place, if a writer is already waiting: waiting for it would
+   deadlock, since it is waiting for this thread.  The caller
+   must then release its read hold and acquire RWLOCK for writing
+   from scratch, rechecking whatever it read.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+rwlock_try_upgrade (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  if (!lock_try_acquire (&rwlock->writer_lock))
+    return false;
+
+  lock_acquire (&rwlock->guard);
+  ASSERT (rwlock->readers > 0);
+  rwlock->readers--;
+  while (rwlock->readers > 0)
+    cond_wait (&rwlock->no_readers, &rwlock->guard);
+  lock_release (&rwlock->guard);
+  return true;
+}
+
+/* Converts the current thread's write hold on RWLOCK into a read
+   hold, letting other readers in. */
+void
+rwlock_downgrade (struct rwlock *rwlock)
+{
+  ASSERT (rwlock_held_for_write (rwlock));
+
+  lock_acquire (&rwlock->guard);
+  rwlock->readers++;
+  lock_release (&rwlock->guard);
+  lock_release (&rwlock->writer_lock);
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise.  There is no corresponding test for readers,
+   since readers are not tracked individually. */
+bool
+rwlock_held_for_write (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  /* A writer still waiting for readers to drain is inside
+     rwlock_acquire_write(), so holding WRITER_LOCK outside it
+     means holding RWLOCK for writing. */
+  return lock_held_by_current_thread (&rwlock->writer_lock);
+}
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore
@@ -17,18 +18,43 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+#ifdef LOCK_STATS
+/* Usage statistics for a lock, collected when the kernel is
+   built with LOCK_STATS defined.  Times are in timer ticks. */
+struct lock_stats
+  {
+    long long acquisitions;     /* # of times acquired. */
+    long long contended;        /* # of acquisitions that had to wait. */
+    int64_t wait_ticks;         /* Total time spent waiting. */
+    int64_t max_wait_ticks;     /* Longest single wait. */
+    int64_t max_hold_ticks;     /* Longest time held. */
+    int64_t acquired_at;        /* When the current holder got it. */
+  };
+#endif
+
 /* Lock. */
 struct lock
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks list. */
+    int priority;               /* Highest priority donated by a waiter. */
+#ifdef LOCK_STATS
+    const char *name;           /* Name, or null if not reported. */
+    struct lock_stats stats;    /* Usage statistics. */
+    struct list_elem stats_elem; /* Element in list of named locks. */
+#endif
   };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+#ifdef LOCK_STATS
+void lock_print_stats (void);
+#endif
 
 /* Condition variable. */
 struct condition
@@ -41,6 +67,26 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock
+  {
+    struct lock writer_lock;    /* Held by the writer, or one waiting. */
+    struct lock guard;          /* Protects READERS. */
+    struct condition no_readers; /* Signaled when READERS drops to 0. */
+    int readers;                /* Number of threads holding for read. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_try_upgrade (struct rwlock *);
+void rwlock_downgrade (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -1,16 +1,21 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
+#include <sched-stats.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -22,14 +27,48 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO list per priority level, and bit P of
+   ready_mask is set if and only if ready_queues[P] is nonempty,
+   so finding the highest-priority ready thread takes constant
+   time no matter how many threads are runnable. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+static struct list ready_queues[PRI_CNT];
+static uint64_t ready_mask;
+static int ready_cnt;           /* # of threads in the run queue. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
+/* Index of live threads by tid, for thread_by_id().  The hash
+   table allocates its buckets with malloc(), so it cannot be set
+   up until thread_start(); threads that exist before then are
+   entered at that point.  A thread whose tid is TID_ERROR is
+   never in the index. */
+static struct hash tid_index;
+static struct lock tid_index_lock;
+static bool tid_index_ready;
+
+/* Pages of recently exited threads, kept for reuse by
+   thread_create() so that short-lived threads do not have to go
+   through the page allocator and zero a whole page each time.
+   Accessed only with interrupts off.
+
+   A cached page's struct thread is left as the dying thread left
+   it.  Its `stack' member marks the lowest stack address that
+   thread was using when it last switched out; thread_page_get()
+   zeroes only from there to the top of the page, and the idle
+   thread zeroes cached pages in full when it has nothing better
+   to do, which sets `stack' to a null pointer.
+
+   The page allocator empties the cache through
+   thread_page_reclaim() when the kernel pool runs out. */
+#define THREAD_PAGE_CACHE_SIZE 8
+static struct thread *thread_page_cache[THREAD_PAGE_CACHE_SIZE];
+static int thread_page_cnt;
+
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -52,6 +91,11 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Wakeup latency histogram: bucket N counts threads that waited
+   between 2**N and 2**(N+1) cycles from thread_unblock() until
+   they started running.  See struct sched_stats. */
+static uint32_t latency_hist[SCHED_LATENCY_BUCKETS];
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
@@ -61,6 +105,31 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the stride scheduler.
+   Controlled by kernel command-line option "-stride". */
+bool thread_stride;
+
+/* Stride scheduler state.  Ready threads are kept in a skew heap
+   keyed on pass, linked through their stride_left and
+   stride_right members, so that picking the thread with the
+   lowest pass and inserting a thread both take amortized O(log n)
+   time.  Each tick a thread runs advances its pass by its stride,
+   STRIDE1 / tickets, so over time each thread runs in proportion
+   to its tickets. */
+#define STRIDE1 (1 << 20)       /* Stride of a thread with 1 ticket. */
+static struct thread *stride_heap;
+static int64_t stride_global_pass;  /* Pass of last thread to run. */
+
+/* 4.4BSD scheduler state. */
+static fixed_t load_avg;        /* System load average. */
+
+/* Threads whose recent_cpu has changed since their priority was
+   last computed.  Only the running thread's recent_cpu changes
+   between the once-per-second updates, so this list stays short
+   and the every-fourth-tick recomputation need not visit every
+   thread. */
+static struct list mlfqs_dirty_list;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -72,6 +141,23 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void account_switch (struct thread *, bool switching);
+static void account_run (struct thread *);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static void thread_page_scrub (void);
+static void tid_index_insert (struct thread *);
+static void tid_index_remove (struct thread *);
+static hash_hash_func tid_hash;
+static hash_less_func tid_less;
+static void ready_queue_push (struct thread *);
+static struct thread *ready_queue_pop (void);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
+static struct thread *stride_heap_merge (struct thread *, struct thread *);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_decay (struct thread *, void *aux);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -89,11 +175,17 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  lock_init (&tid_index_lock);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
+  ready_mask = 0;
   list_init (&all_list);
+  list_init (&mlfqs_dirty_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -108,6 +200,19 @@ void
 thread_start (void)
 {
 	log(L_TRACE, "thread_start");
+  struct list_elem *e;
+
+  /* Build the tid index now that malloc() works, and enter every
+     thread created so far. */
+  if (!hash_init (&tid_index, tid_hash, tid_less, NULL))
+    PANIC ("cannot allocate thread index");
+  lock_acquire (&tid_index_lock);
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    tid_index_insert (list_entry (e, struct thread, allelem));
+  tid_index_ready = true;
+  lock_release (&tid_index_lock);
+
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
@@ -137,6 +242,11 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+  else if (thread_stride && t != idle_thread)
+    t->pass += STRIDE1 / t->tickets;
+
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
@@ -150,6 +260,52 @@ thread_print_stats (void)
           idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Prints scheduler accounting for each live thread and the
+   wakeup latency histogram. */
+void
+thread_print_sched_stats (void)
+{
+  struct list_elem *e;
+  enum intr_level old_level;
+  int i;
+
+  old_level = intr_disable ();
+  printf ("Sched: %4s %-16s %14s %14s %14s %8s %8s\n", "tid", "name",
+          "run cy", "ready cy", "blocked cy", "vol", "invol");
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      printf ("       %4d %-16s %14llu %14llu %14llu %8"PRIu32" %8"PRIu32"\n",
+              t->tid, t->name, t->run_cycles, t->ready_cycles,
+              t->blocked_cycles, t->voluntary_switches,
+              t->involuntary_switches);
+    }
+  printf ("Sched: wakeup-to-run latency (cycles):\n");
+  for (i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+    if (latency_hist[i] != 0)
+      printf ("       >= 2^%-2d %10"PRIu32"\n", i, latency_hist[i]);
+  intr_set_level (old_level);
+}
+
+/* Stores scheduler statistics for the running thread, plus the
+   system-wide latency histogram, into *ST. */
+void
+thread_get_sched_stats (struct sched_stats *st)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  st->run_cycles = cur->run_cycles + (rdtsc () - cur->state_since);
+  st->ready_cycles = cur->ready_cycles;
+  st->blocked_cycles = cur->blocked_cycles;
+  st->voluntary_switches = cur->voluntary_switches;
+  st->involuntary_switches = cur->involuntary_switches;
+  memcpy (st->latency_hist, latency_hist, sizeof latency_hist);
+  intr_set_level (old_level);
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -162,9 +318,8 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, the running thread yields to it immediately. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux)
@@ -178,13 +333,13 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_get ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
-  tid = t->tid = allocate_tid ();
+  tid = t->tid;
   t->nextFd = STDERR_FILENO + 1;
   t->childNo = 0;
   int i;
@@ -208,6 +363,7 @@ thread_create (const char *name, int priority,
 
   /* Add to run queue. */
   thread_unblock (t);
+  thread_preempt ();
 
   return tid;
 }
@@ -232,10 +388,13 @@ thread_block (void)
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
-   it may expect that it can atomically unblock a thread and
-   update other data. */
+   Outside of an interrupt handler this function does not
+   preempt the running thread.  This can be important: if the
+   caller had disabled interrupts itself, it may expect that it
+   can atomically unblock a thread and update other data.  Such
+   callers should call thread_preempt() once they are done.
+   Inside an external interrupt handler, a T that outranks the
+   interrupted thread is run as soon as the handler returns. */
 void
 thread_unblock (struct thread *t)
 {
@@ -245,8 +404,19 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+
+  t->woken_at = rdtsc ();
+  t->blocked_cycles += t->woken_at - t->state_since;
+  t->state_since = t->woken_at;
+
+  /* A thread that has been blocked must not get to run for as
+     long as it takes its pass to catch up with everyone else's. */
+  if (thread_stride && t->pass < stride_global_pass)
+    t->pass = stride_global_pass;
+  ready_queue_push (t);
   t->status = THREAD_READY;
+  if (intr_context ())
+    thread_preempt ();
   intr_set_level (old_level);
 }
 
@@ -294,11 +464,27 @@ thread_exit (void)
   process_exit ();
 #endif
 
+  if (tid_index_ready)
+    {
+      lock_acquire (&tid_index_lock);
+      tid_index_remove (thread_current ());
+      lock_release (&tid_index_lock);
+    }
+
+  /* Return the blocks cached in our malloc() magazines.  This
+     must come after anything that may call malloc() or free(),
+     such as removing ourselves from the tid index above, which
+     can rehash it; a block cached after this point would never
+     be returned. */
+  malloc_thread_exit ();
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
   list_remove (&thread_current()->allelem);
+  if (thread_current ()->mlfqs_dirty)
+    list_remove (&thread_current ()->mlfqs_elem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -316,12 +502,39 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread)
-    list_push_back (&ready_list, &cur->elem);
+    ready_queue_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU if some ready thread has a higher priority than
+   the running thread.  Within an external interrupt handler, the
+   yield is deferred until the handler returns.  The stride
+   scheduler ignores priorities, so there this does nothing. */
+void
+thread_preempt (void)
+{
+  enum intr_level old_level;
+  bool outranked;
+
+  if (thread_stride)
+    return;
+
+  old_level = intr_disable ();
+  outranked = (ready_mask != 0
+               && ready_queue_max_priority () > thread_current ()->priority);
+  intr_set_level (old_level);
+
+  if (outranked)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -339,11 +552,62 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY.  The
+   effective priority stays raised while higher priorities are
+   donated to the thread.  Yields if the running thread no longer
+   has the highest priority.  Has no effect under the 4.4BSD
+   scheduler, which computes priorities itself. */
 void
 thread_set_priority (int new_priority)
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_update_priority (cur);
+  intr_set_level (old_level);
+
+  thread_preempt ();
+}
+
+/* Recomputes T's effective priority as the maximum of its base
+   priority and the priorities donated through each lock that T
+   holds, moving T to its new run queue if it is ready.  The
+   4.4BSD scheduler does not donate, so there the base priority
+   is used as is.  Interrupts must be off. */
+void
+thread_update_priority (struct thread *t)
+{
+  struct list_elem *e;
+  int priority = t->base_priority;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!thread_mlfqs)
+    for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+         e = list_next (e))
+      {
+        struct lock *l = list_entry (e, struct lock, elem);
+        if (l->priority > priority)
+          priority = l->priority;
+      }
+
+  if (priority == t->priority)
+    return;
+  if (t->status == THREAD_READY && !thread_stride)
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else
+    t->priority = priority;
 }
 
 /* Returns the current thread's priority. */
@@ -353,35 +617,156 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's stride scheduler tickets to
+   TICKETS. */
 void
-thread_set_nice (int nice UNUSED)
+thread_set_tickets (int tickets)
 {
-  /* Not yet implemented. */
+  ASSERT (TICKETS_MIN <= tickets && tickets <= TICKETS_MAX);
+
+  thread_current ()->tickets = tickets;
+}
+
+/* Returns the current thread's stride scheduler tickets. */
+int
+thread_get_tickets (void)
+{
+  return thread_current ()->tickets;
+}
+
+/* Sets the current thread's nice value to NICE, recomputes its
+   priority, and yields if it no longer has the highest
+   priority. */
+void
+thread_set_nice (int nice)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (cur);
+  intr_set_level (old_level);
+
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_round (fp_mul_int (load_avg, 100));
+  intr_set_level (old_level);
+
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_round (fp_mul_int (thread_current ()->recent_cpu,
+                                             100));
+  intr_set_level (old_level);
+
+  return recent_cpu_100;
+}
+
+/* Does the 4.4BSD scheduler's bookkeeping for a timer tick that
+   interrupted thread T.  Runs in an external interrupt context.
+
+   Each tick charges T for the CPU time it used.  Once per second
+   the load average and every thread's recent_cpu are updated,
+   which changes every thread's priority.  In between, every
+   fourth tick recomputes the priority of only those threads that
+   were charged in the meantime. */
+static void
+mlfqs_tick (struct thread *t)
+{
+  int64_t now = timer_ticks ();
+
+  if (t != idle_thread)
+    {
+      t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+      if (!t->mlfqs_dirty)
+        {
+          t->mlfqs_dirty = true;
+          list_push_back (&mlfqs_dirty_list, &t->mlfqs_elem);
+        }
+    }
+
+  if (now % TIMER_FREQ == 0)
+    {
+      /* The run queue size is maintained as threads come and go,
+         so the load average costs nothing extra to update. */
+      int ready_threads = ready_cnt + (t != idle_thread ? 1 : 0);
+      load_avg = fp_add (fp_mul (fp_div_int (fp_from_int (59), 60), load_avg),
+                         fp_div_int (fp_from_int (ready_threads), 60));
+      thread_foreach (mlfqs_decay, NULL);
+    }
+
+  if (now % TIME_SLICE == 0)
+    while (!list_empty (&mlfqs_dirty_list))
+      {
+        struct list_elem *e = list_pop_front (&mlfqs_dirty_list);
+        struct thread *d = list_entry (e, struct thread, mlfqs_elem);
+        d->mlfqs_dirty = false;
+        mlfqs_update_priority (d);
+      }
+
+  thread_preempt ();
+}
+
+/* Recomputes T's priority from its recent_cpu and nice values.
+   Interrupts must be off. */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  int priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t == idle_thread)
+    return;
+
+  priority = PRI_MAX - fp_to_int (fp_div_int (t->recent_cpu, 4)) - t->nice * 2;
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+
+  t->base_priority = priority;
+  thread_update_priority (t);
+}
+
+/* Decays T's recent_cpu by the load average and recomputes its
+   priority.  A thread whose recent_cpu and nice are both 0 is
+   unaffected and is skipped.  Used with thread_foreach(). */
+static void
+mlfqs_decay (struct thread *t, void *aux UNUSED)
+{
+  fixed_t twice_load = fp_mul_int (load_avg, 2);
+
+  if (t == idle_thread || (t->recent_cpu == 0 && t->nice == 0))
+    return;
+
+  t->recent_cpu = fp_add_int (fp_mul (fp_div (twice_load,
+                                              fp_add_int (twice_load, 1)),
+                                      t->recent_cpu),
+                              t->nice);
+  mlfqs_update_priority (t);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -391,8 +776,8 @@ thread_get_recent_cpu (void)
    point it initializes idle_thread, "up"s the semaphore passed
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   run queue.  It is returned by next_thread_to_run() as a
+   special case when the run queue is empty. */
 static void
 idle (void *idle_started_ UNUSED)
 {
@@ -406,6 +791,23 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Nothing else is runnable, so this is a good time to clear
+         out a cached thread page. */
+      thread_page_scrub ();
+
+      /* Also zero free pages ahead of PAL_ZERO requests.  Each
+         page is zeroed with interrupts on, so an interrupt may
+         make a thread ready meanwhile without preempting us, as
+         under the stride scheduler or for a PRI_MIN thread.  Stop
+         zeroing if so, and run it instead of halting. */
+      while (ready_cnt == 0 && palloc_zero_idle ())
+        continue;
+      if (ready_cnt > 0)
+        continue;
+
+      /* Stop the timer until something is due. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -469,12 +871,40 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init (&t->held_locks);
+  t->tickets = TICKETS_DEFAULT;
+  t->pass = stride_global_pass;
+  t->state_since = rdtsc ();
   t->magic = THREAD_MAGIC;
 
+  /* allocate_tid() takes a lock, which the initial thread cannot
+     do until thread_init() has marked it running, so
+     thread_init() assigns its tid itself. */
+  if (t != initial_thread)
+    t->tid = allocate_tid ();
+
+  /* Under the 4.4BSD scheduler, a new thread inherits its
+     parent's nice and recent_cpu, and PRIORITY is ignored. */
+  if (thread_mlfqs && t != running_thread ())
+    {
+      struct thread *parent = running_thread ();
+      t->nice = parent->nice;
+      t->recent_cpu = parent->recent_cpu;
+    }
+
   old_level = intr_disable ();
+  if (thread_mlfqs)
+    mlfqs_update_priority (t);
   list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
+
+  if (tid_index_ready)
+    {
+      lock_acquire (&tid_index_lock);
+      tid_index_insert (t);
+      lock_release (&tid_index_lock);
+    }
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -490,6 +920,135 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Returns the index of the most significant set bit in X, which
+   must be nonzero.  Split into halves so that each half compiles
+   to a single BSR instruction on i386. */
+static inline int
+highest_set_bit (uint64_t x)
+{
+  uint32_t hi = x >> 32;
+
+  ASSERT (x != 0);
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  else
+    return 31 - __builtin_clz ((uint32_t) x);
+}
+
+/* Merges skew heaps A and B, either of which may be null, and
+   returns the root of the result.  Works top-down, without
+   recursion, so that a long right spine cannot overflow the
+   kernel stack. */
+static struct thread *
+stride_heap_merge (struct thread *a, struct thread *b)
+{
+  struct thread *root = NULL;
+  struct thread **link = &root;
+
+  while (a != NULL && b != NULL)
+    {
+      struct thread *next;
+
+      if (b->pass < a->pass)
+        {
+          struct thread *tmp = a;
+          a = b;
+          b = tmp;
+        }
+
+      /* A becomes the root of this subtree.  The rest of the
+         merge goes into its left subtree, and its old left
+         subtree moves right. */
+      *link = a;
+      next = a->stride_right;
+      a->stride_right = a->stride_left;
+      link = &a->stride_left;
+      a = next;
+    }
+  *link = a != NULL ? a : b;
+  return root;
+}
+
+/* Adds T to the back of the run queue for its priority, or to
+   the stride heap under the stride scheduler.
+   Interrupts must be off. */
+static void
+ready_queue_push (struct thread *t)
+{
+  int pri = t->priority - PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_stride)
+    {
+      t->stride_left = t->stride_right = NULL;
+      stride_heap = stride_heap_merge (stride_heap, t);
+      ready_cnt++;
+      return;
+    }
+
+  list_push_back (&ready_queues[pri], &t->elem);
+  ready_mask |= (uint64_t) 1 << pri;
+  ready_cnt++;
+}
+
+/* Removes and returns the thread at the front of the
+   highest-priority nonempty run queue, or the thread with the
+   lowest pass under the stride scheduler.  The run queue must
+   not be empty.  Interrupts must be off. */
+static struct thread *
+ready_queue_pop (void)
+{
+  int pri;
+  struct list *q;
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_stride)
+    {
+      t = stride_heap;
+      stride_heap = stride_heap_merge (t->stride_left, t->stride_right);
+      stride_global_pass = t->pass;
+      ready_cnt--;
+      return t;
+    }
+
+  pri = highest_set_bit (ready_mask);
+  q = &ready_queues[pri];
+
+  t = list_entry (list_pop_front (q), struct thread, elem);
+  if (list_empty (q))
+    ready_mask &= ~((uint64_t) 1 << pri);
+  ready_cnt--;
+  return t;
+}
+
+/* Removes ready thread T from the run queue.  Not supported by
+   the stride scheduler.  Interrupts must be off. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  int pri = t->priority - PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+  ASSERT (!thread_stride);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[pri]))
+    ready_mask &= ~((uint64_t) 1 << pri);
+  ready_cnt--;
+}
+
+/* Returns the priority of the highest-priority ready thread.
+   The run queue must not be empty.  Interrupts must be off. */
+static int
+ready_queue_max_priority (void)
+{
+  return highest_set_bit (ready_mask) + PRI_MIN;
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
@@ -498,10 +1057,10 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void)
 {
-  if (list_empty (&ready_list))
+  if (ready_cnt == 0)
     return idle_thread;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return ready_queue_pop ();
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -528,6 +1087,7 @@ thread_schedule_tail (struct thread *prev)
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Mark us as running. */
+  account_run (cur);
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
@@ -546,7 +1106,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_page_put (prev);
     }
 }
 
@@ -568,11 +1128,133 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  account_switch (cur, cur != next);
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
 }
 
+/* Charges the time since CUR started running to it, now that it
+   has stopped.  If SWITCHING, another thread is about to run, so
+   also counts a voluntary or involuntary switch, depending on
+   whether CUR is still runnable.  Interrupts must be off. */
+static void
+account_switch (struct thread *cur, bool switching)
+{
+  uint64_t now = rdtsc ();
+
+  cur->run_cycles += now - cur->state_since;
+  cur->state_since = now;
+  if (switching)
+    {
+      if (cur->status == THREAD_READY)
+        cur->involuntary_switches++;
+      else
+        cur->voluntary_switches++;
+    }
+}
+
+/* Charges the time since CUR became ready to it, now that it is
+   about to run, and records its wakeup latency if it got here
+   from thread_unblock().  Interrupts must be off. */
+static void
+account_run (struct thread *cur)
+{
+  uint64_t now = rdtsc ();
+
+  cur->ready_cycles += now - cur->state_since;
+  cur->state_since = now;
+  if (cur->woken_at != 0)
+    {
+      uint64_t latency = now - cur->woken_at;
+      int bucket = latency != 0 ? highest_set_bit (latency) : 0;
+      if (bucket >= SCHED_LATENCY_BUCKETS)
+        bucket = SCHED_LATENCY_BUCKETS - 1;
+      latency_hist[bucket]++;
+      cur->woken_at = 0;
+    }
+}
+
+/* Returns a page for a new thread, preferring one from the
+   thread page cache.  Only the part of a cached page that the
+   new thread's initial stack frames will occupy is zeroed here;
+   init_thread() takes care of the struct thread itself.  Returns
+   a null pointer if no page is available. */
+static struct thread *
+thread_page_get (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (thread_page_cnt > 0)
+    t = thread_page_cache[--thread_page_cnt];
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    return palloc_get_page (PAL_ZERO);
+
+  if (t->stack != NULL)
+    {
+      uint8_t *top = (uint8_t *) t + PGSIZE;
+      ASSERT (t->stack > (uint8_t *) (t + 1) && t->stack <= top);
+      memset (t->stack, 0, top - t->stack);
+    }
+  return t;
+}
+
+/* Releases the page of dead thread T, caching it for reuse if
+   there is room.  Interrupts must be off. */
+static void
+thread_page_put (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_DYING);
+
+  if (thread_page_cnt < THREAD_PAGE_CACHE_SIZE)
+    thread_page_cache[thread_page_cnt++] = t;
+  else
+    palloc_free_page (t);
+}
+
+/* Zeroes one cached thread page that may still hold stale data
+   from the thread that last used it.  Called from the idle
+   thread with interrupts off. */
+static void
+thread_page_scrub (void)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < thread_page_cnt; i++)
+    if (thread_page_cache[i]->stack != NULL)
+      {
+        memset (thread_page_cache[i], 0, PGSIZE);
+        return;
+      }
+}
+
+/* Returns every page in the thread page cache to the page
+   allocator.  Returns the number of pages freed.  Called by the
+   page allocator when the kernel pool is exhausted. */
+size_t
+thread_page_reclaim (void)
+{
+  enum intr_level old_level;
+  size_t freed = 0;
+
+  old_level = intr_disable ();
+  while (thread_page_cnt > 0)
+    {
+      palloc_free_page (thread_page_cache[--thread_page_cnt]);
+      freed++;
+    }
+  intr_set_level (old_level);
+
+  return freed;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void)
@@ -590,18 +1272,85 @@ allocate_tid (void)
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
-/* Return a thread based off tid. */
-struct thread * thread_by_id(tid_t tid){
-  struct list_elem *e;
+/* Returns the thread whose tid is TID, or a null pointer if
+   there is no such thread. */
+struct thread *
+thread_by_id (tid_t tid)
+{
+  /* Lookup key.  Far too big for the kernel stack, so it is
+     static and, like the index, protected by tid_index_lock. */
+  static struct thread key;
+  struct hash_elem *e;
+
+  if (!tid_index_ready)
+    return NULL;
+
+  lock_acquire (&tid_index_lock);
+  key.tid = tid;
+  e = hash_find (&tid_index, &key.tid_elem);
+  lock_release (&tid_index_lock);
+  return e != NULL ? hash_entry (e, struct thread, tid_elem) : NULL;
+}
 
-  for (e = list_begin (&all_list); e != list_end (&all_list);
-       e = list_next (e))
+/* Changes T's tid to TID, keeping the tid index up to date.
+   Setting TID_ERROR removes T from the index, so that
+   thread_by_id() no longer finds it. */
+void
+thread_set_tid (struct thread *t, tid_t tid)
+{
+  ASSERT (is_thread (t));
+
+  if (!tid_index_ready)
     {
-      struct thread *t = list_entry (e, struct thread, allelem);
-      if(t->tid == tid){
-	return t;
-      }
+      t->tid = tid;
+      return;
     }
-  return NULL;
+
+  lock_acquire (&tid_index_lock);
+  tid_index_remove (t);
+  t->tid = tid;
+  tid_index_insert (t);
+  lock_release (&tid_index_lock);
 }
 
+/* Adds T to the tid index, unless its tid is TID_ERROR.  The
+   caller must hold tid_index_lock. */
+static void
+tid_index_insert (struct thread *t)
+{
+  ASSERT (lock_held_by_current_thread (&tid_index_lock));
+
+  if (t->tid != TID_ERROR)
+    {
+      struct hash_elem *old = hash_insert (&tid_index, &t->tid_elem);
+      ASSERT (old == NULL);
+    }
+}
+
+/* Removes T from the tid index, if it is there.  The caller
+   must hold tid_index_lock. */
+static void
+tid_index_remove (struct thread *t)
+{
+  ASSERT (lock_held_by_current_thread (&tid_index_lock));
+
+  if (t->tid != TID_ERROR)
+    hash_delete (&tid_index, &t->tid_elem);
+}
+
+/* Returns a hash value for the thread containing E. */
+static unsigned
+tid_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct thread, tid_elem)->tid);
+}
+
+/* Returns true if the thread containing A has a lower tid than
+   the one containing B. */
+static bool
+tid_less (const struct hash_elem *a, const struct hash_elem *b,
+          void *aux UNUSED)
+{
+  return (hash_entry (a, struct thread, tid_elem)->tid
+          < hash_entry (b, struct thread, tid_elem)->tid);
+}
@@ -2,11 +2,15 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
-#include "filesys/file.h"
+#include "threads/fixed-point.h"
+#include "threads/malloc.h"
 #include "synch.h"
 
+struct file;
+
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -27,6 +31,16 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread tickets, for the stride scheduler. */
+#define TICKETS_MIN 1                   /* Smallest CPU share. */
+#define TICKETS_DEFAULT 100             /* Default CPU share. */
+#define TICKETS_MAX 1000                /* Largest CPU share. */
+
+/* Thread niceness, for the 4.4BSD scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice to other threads. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -77,12 +91,14 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member has a triple purpose.  It can be an element
+   in the run queue (thread.c), an element in a semaphore wait
+   list (synch.c), or an element in the sleep wheel (timer.c).
+   It can be used these ways only because they are mutually
+   exclusive: only a thread in the ready state is on the run
+   queue, whereas only a thread in the blocked state is on a
+   semaphore wait list or the sleep wheel, and a thread blocked
+   in timer_sleep() is not waiting on any semaphore. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -90,12 +106,45 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority before donations. */
     struct list_elem allelem;           /* List element for all threads list. */
+    struct hash_elem tid_elem;          /* Element in tid index. */
 
-    /* Shared between thread.c and synch.c. */
+    /* Shared between thread.c, synch.c, and devices/timer.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_tick;                /* Tick to wake up at, if asleep. */
+
+    /* Owned by synch.c. */
+    struct lock *waiting_lock;          /* Lock being waited for, if any. */
+    struct list held_locks;             /* Locks held, for donation. */
+
+    /* Owned by thread.c, for the 4.4BSD scheduler. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* Recent CPU time received. */
+    bool mlfqs_dirty;                   /* On mlfqs_dirty_list? */
+    struct list_elem mlfqs_elem;        /* Element in mlfqs_dirty_list. */
+
+    /* Owned by thread.c, for the stride scheduler. */
+    int tickets;                        /* Share of the CPU. */
+    int64_t pass;                       /* Virtual time; lowest runs next. */
+    struct thread *stride_left;         /* Children in stride_heap. */
+    struct thread *stride_right;
+
+    /* Owned by thread.c, for scheduler accounting, in cycles. */
+    uint64_t state_since;               /* When status last changed. */
+    uint64_t run_cycles;                /* Time spent running. */
+    uint64_t ready_cycles;              /* Time spent ready. */
+    uint64_t blocked_cycles;            /* Time spent blocked. */
+    uint64_t woken_at;                  /* When last unblocked, or 0. */
+    uint32_t voluntary_switches;        /* Switches away while blocked. */
+    uint32_t involuntary_switches;      /* Switches away while ready. */
+
+    /* Owned by threads/malloc.c. */
+    struct magazine magazines[MALLOC_CLASS_CNT]; /* Cached free blocks. */
+
     struct semaphore exiting;
     struct semaphore reaped;
     struct semaphore launched;
@@ -109,6 +158,10 @@ struct thread
     uint32_t *pagedir;     /* Page directory. */
     int32_t exit_status;
 #endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+#endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -124,11 +177,21 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the stride scheduler, which divides the CPU among
+   ready threads in proportion to their tickets and ignores
+   priorities.  Controlled by kernel command-line option
+   "-stride". */
+extern bool thread_stride;
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_print_sched_stats (void);
+
+struct sched_stats;
+void thread_get_sched_stats (struct sched_stats *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -142,6 +205,7 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -149,11 +213,18 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *);
+
+int thread_get_tickets (void);
+void thread_set_tickets (int);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-struct thread * thread_by_id(tid_t thread_id);
+struct thread *thread_by_id (tid_t);
+void thread_set_tid (struct thread *, tid_t);
+
+size_t thread_page_reclaim (void);
 #endif /* threads/thread.h */
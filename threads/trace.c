@@ -0,0 +1,58 @@
+#include "threads/trace.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/thread.h"
+
+#ifdef KTRACE
+/* Number of records in the ring buffer.  Must be a power of 2. */
+#define TRACE_RECORDS 2048
+
+/* Ring buffer.  Once it fills up, new records replace the
+   oldest.  Protected by disabling interrupts, which is enough
+   on a uniprocessor and much cheaper than a lock. */
+static struct trace_record records[TRACE_RECORDS];
+static uint32_t trace_next;     /* Total number of records ever made. */
+
+/* Appends a record of FORMAT with arguments A...D to the trace
+   buffer.  Use TRACE() instead of calling this directly.  May be
+   called from interrupt handlers, but not before thread_init()
+   or from inside the scheduler, where there is no well-defined
+   current thread. */
+void
+trace_event (const char *format, uint32_t a, uint32_t b, uint32_t c,
+             uint32_t d)
+{
+  enum intr_level old_level = intr_disable ();
+  struct trace_record *r = &records[trace_next++ & (TRACE_RECORDS - 1)];
+
+  r->tsc = rdtsc ();
+  r->tid = thread_current ()->tid;
+  r->format = format;
+  r->args[0] = a;
+  r->args[1] = b;
+  r->args[2] = c;
+  r->args[3] = d;
+  intr_set_level (old_level);
+}
+
+/* Prints the trace buffer, oldest record first, one record per
+   line, for utils/trace-decode. */
+void
+trace_dump (void)
+{
+  uint32_t first, i;
+
+  first = trace_next > TRACE_RECORDS ? trace_next - TRACE_RECORDS : 0;
+  printf ("Trace: %"PRIu32" events, %"PRIu32" recorded\n",
+          trace_next, trace_next - first);
+  for (i = first; i != trace_next; i++)
+    {
+      const struct trace_record *r = &records[i & (TRACE_RECORDS - 1)];
+      printf ("TRACE %"PRIx64" %"PRId32" %p %"PRIx32" %"PRIx32
+              " %"PRIx32" %"PRIx32"\n", r->tsc, r->tid, r->format,
+              r->args[0], r->args[1], r->args[2], r->args[3]);
+    }
+}
+#endif /* KTRACE */
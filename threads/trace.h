@@ -0,0 +1,42 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdint.h>
+
+/* Kernel tracepoints.
+
+   TRACE (FORMAT, ...) records an event with up to four integer
+   or pointer arguments in a ring buffer in memory.  FORMAT must
+   be a string literal: only its address is recorded, and
+   nothing is formatted until utils/trace-decode reads the dump
+   printed at shutdown and looks the string up in kernel.o.  %s
+   arguments are printed only if they, too, point into the
+   kernel image.
+
+   Tracepoints compile to nothing unless the kernel is built with
+   "make KTRACE=1". */
+
+/* One trace record. */
+struct trace_record
+  {
+    uint64_t tsc;               /* Time-stamp counter at event. */
+    int32_t tid;                /* Thread that recorded the event. */
+    const char *format;         /* Event format string. */
+    uint32_t args[4];           /* Event arguments. */
+  };
+
+#ifdef KTRACE
+#define TRACE(...) TRACE_ (__VA_ARGS__, 0, 0, 0, 0)
+#define TRACE_(FORMAT, A, B, C, D, ...)                                 \
+        trace_event ("" FORMAT, (uint32_t) (A), (uint32_t) (B),         \
+                     (uint32_t) (C), (uint32_t) (D))
+
+void trace_event (const char *format, uint32_t, uint32_t, uint32_t,
+                  uint32_t);
+void trace_dump (void);
+#else
+#define TRACE(...) ((void) 0)
+#define trace_dump() ((void) 0)
+#endif
+
+#endif /* threads/trace.h */
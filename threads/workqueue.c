@@ -0,0 +1,316 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Kernel work queues.
+
+   Rather than creating a thread for each piece of deferred or
+   background work, kernel code embeds a struct work in its own
+   data and hands it to queue_work().  A fixed pool of worker
+   threads, started by workqueue_init(), runs queued items in
+   FIFO order within each queue, taking turns among queues that
+   have work pending.  Items may also be queued to run after a
+   given number of timer ticks with queue_delayed_work().
+
+   All the shared state here is protected by disabling
+   interrupts, so queue_work(), queue_delayed_work(), and
+   cancel_work() may be called from interrupt handlers.  Work
+   functions themselves run in a worker thread with interrupts
+   on, and may sleep.
+
+   A queue is not serialized: with more than one worker, two
+   items from the same queue may run at the same time, so work
+   functions must do their own locking. */
+
+/* Number of worker threads. */
+#define WORKER_CNT 2
+
+struct workqueue system_wq;
+
+/* Queues that have pending work, in the order they will be
+   served. */
+static struct list scheduled_queues;
+
+/* Delayed work items, ordered by the tick they are due. */
+static struct list delayed_list;
+
+/* Upped once per queued work item.  Workers wait on it. */
+static struct semaphore work_available;
+
+/* Set once workqueue_init() has run. */
+static bool workqueue_ready;
+
+static thread_func worker;
+static void enqueue (struct workqueue *, struct work *);
+static bool when_less (const struct list_elem *, const struct list_elem *,
+                       void *aux);
+
+/* Initializes the work queue subsystem and starts the worker
+   threads.  Must be called after thread_start(). */
+void
+workqueue_init (void)
+{
+  int i;
+
+  list_init (&scheduled_queues);
+  list_init (&delayed_list);
+  sema_init (&work_available, 0);
+  workqueue_create (&system_wq, "system");
+  workqueue_ready = true;
+
+  for (i = 0; i < WORKER_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "worker %d", i);
+      if (thread_create (name, PRI_DEFAULT, worker, NULL) == TID_ERROR)
+        PANIC ("cannot start work queue worker");
+    }
+}
+
+/* Queues every delayed work item that is due at tick NOW.
+   Called by the timer interrupt handler at each tick. */
+void
+workqueue_tick (int64_t now)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!workqueue_ready)
+    return;
+
+  while (!list_empty (&delayed_list))
+    {
+      struct work *w = list_entry (list_front (&delayed_list),
+                                   struct work, elem);
+      if (w->when > now)
+        break;
+      list_pop_front (&delayed_list);
+      enqueue (w->wq, w);
+    }
+}
+
+/* Returns the tick at which the next delayed work item is due,
+   or INT64_MAX if none is pending.  Interrupts must be off. */
+int64_t
+workqueue_next_due (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!workqueue_ready || list_empty (&delayed_list))
+    return INT64_MAX;
+  return list_entry (list_front (&delayed_list), struct work, elem)->when;
+}
+
+/* Initializes WQ as an empty work queue named NAME. */
+void
+workqueue_create (struct workqueue *wq, const char *name)
+{
+  ASSERT (wq != NULL);
+  ASSERT (name != NULL);
+
+  wq->name = name;
+  list_init (&wq->pending);
+  wq->busy = 0;
+  wq->scheduled = false;
+  wq->flush_waiters = 0;
+  sema_init (&wq->flushed, 0);
+}
+
+/* Waits until every item queued on WQ has finished running,
+   including items queued while waiting.  Delayed items that are
+   not yet due are not waited for. */
+void
+flush_workqueue (struct workqueue *wq)
+{
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  if (wq->busy > 0)
+    {
+      wq->flush_waiters++;
+      sema_down (&wq->flushed);
+    }
+  intr_set_level (old_level);
+}
+
+/* Initializes W to run FUNC when it is queued. */
+void
+work_init (struct work *w, work_func *func)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->state = WORK_IDLE;
+  w->wq = NULL;
+}
+
+/* Queues W to run on WQ.  Returns true if successful, false if
+   W was already queued or delayed.  A work item that is running
+   may queue itself again.
+
+   May be called from an interrupt handler. */
+bool
+queue_work (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+  bool success = false;
+
+  ASSERT (workqueue_ready);
+
+  old_level = intr_disable ();
+  if (w->state == WORK_IDLE)
+    {
+      enqueue (wq, w);
+      success = true;
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Queues W to run on WQ once TICKS timer ticks have elapsed.
+   If TICKS is 0 or less, queues W right away.  Returns true if
+   successful, false if W was already queued or delayed.
+
+   May be called from an interrupt handler. */
+bool
+queue_delayed_work (struct workqueue *wq, struct work *w, int64_t ticks)
+{
+  enum intr_level old_level;
+  bool success = false;
+
+  ASSERT (workqueue_ready);
+
+  if (ticks <= 0)
+    return queue_work (wq, w);
+
+  old_level = intr_disable ();
+  if (w->state == WORK_IDLE)
+    {
+      w->state = WORK_DELAYED;
+      w->wq = wq;
+      w->when = timer_ticks () + ticks;
+      list_insert_ordered (&delayed_list, &w->elem, when_less, NULL);
+      success = true;
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Removes W from its queue or from the delayed list, if it has
+   not started running yet.  Returns true if W was removed, false
+   if it was not queued.  Does not wait for W to finish if it is
+   already running.
+
+   May be called from an interrupt handler. */
+bool
+cancel_work (struct work *w)
+{
+  enum intr_level old_level;
+  bool success = true;
+
+  old_level = intr_disable ();
+  switch (w->state)
+    {
+    case WORK_IDLE:
+      success = false;
+      break;
+
+    case WORK_DELAYED:
+      list_remove (&w->elem);
+      break;
+
+    case WORK_QUEUED:
+      /* The worker woken for W will find nothing to do. */
+      list_remove (&w->elem);
+      if (list_empty (&w->wq->pending) && w->wq->scheduled)
+        {
+          list_remove (&w->wq->elem);
+          w->wq->scheduled = false;
+        }
+      if (--w->wq->busy == 0)
+        for (; w->wq->flush_waiters > 0; w->wq->flush_waiters--)
+          sema_up (&w->wq->flushed);
+      break;
+    }
+  w->state = WORK_IDLE;
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Appends W to WQ and wakes a worker for it.  Interrupts must be
+   off. */
+static void
+enqueue (struct workqueue *wq, struct work *w)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  w->state = WORK_QUEUED;
+  w->wq = wq;
+  list_push_back (&wq->pending, &w->elem);
+  wq->busy++;
+  if (!wq->scheduled)
+    {
+      list_push_back (&scheduled_queues, &wq->elem);
+      wq->scheduled = true;
+    }
+  sema_up (&work_available);
+}
+
+/* Worker thread.  Repeatedly takes the oldest item from the next
+   queue with pending work and runs it. */
+static void
+worker (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct workqueue *wq;
+      struct work *w;
+      enum intr_level old_level;
+
+      sema_down (&work_available);
+
+      old_level = intr_disable ();
+      if (list_empty (&scheduled_queues))
+        {
+          /* The item we were woken for was cancelled. */
+          intr_set_level (old_level);
+          continue;
+        }
+      wq = list_entry (list_pop_front (&scheduled_queues),
+                       struct workqueue, elem);
+      w = list_entry (list_pop_front (&wq->pending), struct work, elem);
+      if (!list_empty (&wq->pending))
+        list_push_back (&scheduled_queues, &wq->elem);
+      else
+        wq->scheduled = false;
+      w->state = WORK_IDLE;
+      intr_set_level (old_level);
+
+      /* W may be freed or requeued by its function, so it must
+         not be touched afterward. */
+      w->func (w);
+
+      old_level = intr_disable ();
+      if (--wq->busy == 0)
+        for (; wq->flush_waiters > 0; wq->flush_waiters--)
+          sema_up (&wq->flushed);
+      intr_set_level (old_level);
+    }
+}
+
+/* Returns true if work item A is due before work item B. */
+static bool
+when_less (const struct list_elem *a_, const struct list_elem *b_,
+           void *aux UNUSED)
+{
+  const struct work *a = list_entry (a_, struct work, elem);
+  const struct work *b = list_entry (b_, struct work, elem);
+
+  return a->when < b->when;
+}
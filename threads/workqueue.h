@@ -0,0 +1,62 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+struct work;
+
+/* Function run by a worker thread to carry out W.  It may free
+   W, or queue it again. */
+typedef void work_func (struct work *w);
+
+/* States of a work item. */
+enum work_state
+  {
+    WORK_IDLE,                  /* Not queued; may be running. */
+    WORK_DELAYED,               /* Waiting for its timer tick. */
+    WORK_QUEUED                 /* On a work queue, not yet run. */
+  };
+
+/* A unit of deferred work.  Usually embedded in a larger
+   structure, which the work function retrieves with
+   list_entry()-style pointer arithmetic on its argument. */
+struct work
+  {
+    work_func *func;            /* Function to run. */
+    enum work_state state;      /* Current state. */
+    struct workqueue *wq;       /* Queue it was last queued on. */
+    int64_t when;               /* Tick to queue at, if delayed. */
+    struct list_elem elem;      /* Queue or delayed list element. */
+  };
+
+/* A FIFO of work items, run by the shared pool of workers. */
+struct workqueue
+  {
+    const char *name;           /* Name (for debugging purposes). */
+    struct list pending;        /* Queued work items, oldest first. */
+    int busy;                   /* # of items queued or running. */
+    bool scheduled;             /* On the list of queues to serve? */
+    struct list_elem elem;      /* Element in that list. */
+    int flush_waiters;          /* # of threads in flush_workqueue(). */
+    struct semaphore flushed;   /* Upped when BUSY drops to 0. */
+  };
+
+/* General-purpose queue for work that needs no queue of its own. */
+extern struct workqueue system_wq;
+
+void workqueue_init (void);
+void workqueue_tick (int64_t now);
+int64_t workqueue_next_due (void);
+
+void workqueue_create (struct workqueue *, const char *name);
+void flush_workqueue (struct workqueue *);
+
+void work_init (struct work *, work_func *);
+bool queue_work (struct workqueue *, struct work *);
+bool queue_delayed_work (struct workqueue *, struct work *, int64_t ticks);
+bool cancel_work (struct work *);
+
+#endif /* threads/workqueue.h */
@@ -5,6 +5,10 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "syscall.h"
+#ifdef VM
+#include "threads/vaddr.h"
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -109,19 +113,44 @@ kill (struct intr_frame *f)
     }
 }
 
-/* Page fault handler.  This is a skeleton that must be filled in
-   to implement virtual memory.  Some solutions to project 2 may
-   also require modifying this code.
+/* Page fault handler.
+
+   With VM, a fault on a page that is in the process's address
+   space but has not been loaded yet is resolved by loading it
+   (see vm/page.c), whether the process touched the page itself
+   or the kernel touched it on the process's behalf.  Any other
+   fault kills the process.
 
    At entry, the address that faulted is in CR2 (Control Register
    2) and information about the fault, formatted as described in
-   the PF_* macros in exception.h, is in F's error_code member.  The
-   example code here shows how to parse that information.  You
-   can find more information about both of these in the
+   the PF_* macros in exception.h, is in F's error_code member.
+   You can find more information about both of these in the
    description of "Interrupt 14--Page Fault Exception (#PF)" in
    [IA32-v3a] section 5.15 "Exception and Interrupt Reference". */
 static void
 page_fault (struct intr_frame *f)
 {
+#ifdef VM
+  bool not_present;  /* True: not-present page, false: writing r/o page. */
+  void *fault_addr;  /* Fault address. */
+
+  /* Obtain faulting address, the virtual address that was
+     accessed to cause the fault.  It may point to code or to
+     data.  It is not necessarily the address of the instruction
+     that caused the fault (that's f->eip). */
+  asm ("movl %%cr2, %0" : "=r" (fault_addr));
+
+  /* Turn interrupts back on (they were only off so that we could
+     be assured of reading CR2 before it changed).  Loading a page
+     may need to wait for the disk. */
+  intr_enable ();
+
+  /* Count page faults. */
+  page_fault_cnt++;
+
+  not_present = (f->error_code & PF_P) == 0;
+  if (not_present && is_user_vaddr (fault_addr) && page_load (fault_addr))
+    return;
+#endif
   sys_exit(-1);
 }
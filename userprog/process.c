@@ -19,6 +19,9 @@
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "syscall.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 #define LOGGING_LEVEL 6
 
@@ -83,7 +86,7 @@ process_execute (const char *command)
     sema_down(&t->launched);
     if (!t->launch_success){
       tid = TID_ERROR;
-      t->tid = TID_ERROR;
+      thread_set_tid (t, TID_ERROR);
     }
     int childNo = cur->childNo;
     cur->child_tid[childNo] = tid;
@@ -187,6 +190,9 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
+#ifdef VM
+      page_table_destroy ();
+#endif
       child_t->pagedir = NULL;
       pagedir_activate (NULL);
       pagedir_destroy (pd);
@@ -322,6 +328,14 @@ load (const char *cmdstr, void (**eip) (void), void **esp)
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
     goto done;
+#ifdef VM
+  if (!page_table_init ())
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto done;
+    }
+#endif
   process_activate ();
 
   //file to be opened and loaded is the first token of the cmdstr
@@ -432,7 +446,9 @@ load (const char *cmdstr, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -491,6 +507,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only added to the process's
+   supplemental page table here, and each is read or zeroed when
+   it is first touched.  FILE must then stay open for as long as
+   the process runs.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -503,6 +524,29 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 
   log(L_TRACE, "load_segment()");
 
+#ifdef VM
+  while (read_bytes > 0 || zero_bytes > 0)
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      bool success;
+
+      if (page_read_bytes > 0)
+        success = page_add_file (upage, file, ofs, page_read_bytes,
+                                 writable);
+      else
+        success = page_add_zero (upage, writable);
+      if (!success)
+        return false;
+
+      /* Advance. */
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0)
     {
@@ -538,6 +582,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 
@@ -568,10 +613,23 @@ setup_stack (const char *cmdstr, void **esp)
   
   log(L_TRACE, "setup_stack()");
 
+#ifdef VM
+  /* The stack page is written right away, so load it now. */
+  kpage = NULL;
+  if (page_add_zero (((uint8_t *) PHYS_BASE) - PGSIZE, true)
+      && page_load (((uint8_t *) PHYS_BASE) - PGSIZE))
+    kpage = pagedir_get_page (thread_current ()->pagedir,
+                              ((uint8_t *) PHYS_BASE) - PGSIZE);
+#else
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+#endif
   if (kpage != NULL)
     {
+#ifdef VM
+      success = true;
+#else
       success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
+#endif
       if (success) {
 	*esp = PHYS_BASE;
 	for(k = no_of_tokens; k >=0; k--){
@@ -617,6 +675,7 @@ setup_stack (const char *cmdstr, void **esp)
   return success;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -636,3 +695,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <sched-stats.h>
 #include <syscall-nr.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -10,12 +11,16 @@
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
 #include "process.h"
 #include "devices/shutdown.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 #define CODE_PHYS_BASE 0x08048000
 
-static struct lock file_lock;
+struct lock file_lock;
 
 
 static void syscall_handler (struct intr_frame *);
@@ -32,11 +37,13 @@ tid_t sys_exec (const char *cmd_line);
 int sys_write (int fd, void *buffer, unsigned size);
 int sys_read (int fd, void *buffer, unsigned size);
 bool is_file_open (char *fileName);
+static bool is_valid_buffer (uint32_t *pd, const void *buffer, unsigned size,
+                             bool write);
 
 void syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init (&file_lock);
+  lock_init_named (&file_lock, "file_lock");
 }
 
 static void syscall_handler (struct intr_frame *f UNUSED)
@@ -118,7 +125,7 @@ static void syscall_handler (struct intr_frame *f UNUSED)
       break;
     }
 
-    if(!is_valid_memory_access(t->pagedir, (void *)arg2)){
+    if(!is_valid_buffer(t->pagedir, (void *)arg2, (unsigned)arg3, true)){
       sys_exit(-1);
       break;
     }
@@ -160,7 +167,7 @@ static void syscall_handler (struct intr_frame *f UNUSED)
       break;
     }
 
-    if(!is_valid_memory_access(t->pagedir, (void *)arg2)){
+    if(!is_valid_buffer(t->pagedir, (void *)arg2, (unsigned)arg3, false)){
       sys_exit(-1);
       break;
     }
@@ -197,6 +204,16 @@ static void syscall_handler (struct intr_frame *f UNUSED)
     f->eax = sys_wait((tid_t)arg1);
     break;
 
+  case SYS_SCHEDSTATS:
+    if(!is_valid_buffer(t->pagedir, (void *)arg1,
+                        sizeof (struct sched_stats), true)){
+      sys_exit(-1);
+      break;
+    }
+    thread_get_sched_stats ((struct sched_stats *)arg1);
+    f->eax = true;
+    break;
+
   default:
     sys_exit(-1);
   }
@@ -206,14 +223,49 @@ static void syscall_handler (struct intr_frame *f UNUSED)
 
 /*
 checks for validity of the address
+With VM, a page that is in the address space but has not been
+touched yet is loaded here.
 */
 bool is_valid_memory_access(uint32_t *pd, const void *vaddr ){
   //if ( vaddr != NULL &&  vaddr < ((void *)LOADER_PHYS_BASE) && vaddr > ((void *)CODE_PHYS_BASE) && pagedir_get_page (pd, vaddr) != NULL){
-  if ( vaddr != NULL &&  vaddr < ((void *)LOADER_PHYS_BASE) && pagedir_get_page (pd, vaddr) != NULL){
+  if ( vaddr == NULL || vaddr >= ((void *)LOADER_PHYS_BASE)){
+    return false;
+  }
+  if (pagedir_get_page (pd, vaddr) != NULL){
     return true;
-  } else {
+  }
+#ifdef VM
+  return page_load (vaddr);
+#else
+  return false;
+#endif
+}
+
+/*
+checks every page of the SIZE bytes at BUFFER, not just the first,
+so that with VM they are all loaded before the file system lock is
+taken: a fault on a user buffer in the middle of a disk read could
+not be resolved.
+If WRITE is true, the kernel is about to store into BUFFER, so every
+page must also be mapped writable.
+*/
+static bool is_valid_buffer(uint32_t *pd, const void *buffer, unsigned size,
+                            bool write){
+  const uint8_t *p = buffer;
+  const uint8_t *last = p + (size > 0 ? size - 1 : 0);
+
+  if (last < p || !is_valid_memory_access(pd, p)
+      || (write && !pagedir_is_writable(pd, p))){
     return false;
   }
+  for (p = (const uint8_t *) pg_round_down (p) + PGSIZE;
+       p <= last && p > (const uint8_t *) buffer; p += PGSIZE){
+    if (!is_valid_memory_access(pd, p)
+        || (write && !pagedir_is_writable(pd, p))){
+      return false;
+    }
+  }
+  return true;
 }
 
 
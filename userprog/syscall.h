@@ -1,6 +1,13 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Serializes access to the file system. */
+extern struct lock file_lock;
+
 void syscall_init (void);
 void sys_exit (int status);
 bool is_valid_memory_access(uint32_t *pd, const void *vaddr );
@@ -0,0 +1,118 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The frame table.
+
+   Every page of the user pool that backs a page of a process's
+   virtual memory is recorded here, keyed by its kernel virtual
+   address, along with the process and the user address that map
+   it.  Frames are only ever allocated when a page is first
+   touched, by page_load(), and freed when the process exits;
+   there is no swap, so a process that cannot get a frame is
+   killed. */
+static struct hash frames;
+
+/* Protects FRAMES. */
+static struct lock frame_lock;
+
+/* Cache of `struct frame's. */
+static struct kmem_cache frame_cache;
+
+static hash_hash_func frame_hash;
+static hash_less_func frame_less;
+static struct frame *frame_lookup (void *kpage);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  hash_init (&frames, frame_hash, frame_less, NULL);
+  lock_init_named (&frame_lock, "frame_lock");
+  kmem_cache_create (&frame_cache, "frame", sizeof (struct frame), NULL);
+}
+
+/* Obtains a page from the user pool, passing FLAGS on to
+   palloc_get_page(), records it in the frame table as backing
+   the running process's page UPAGE, and returns its kernel
+   virtual address.  Returns a null pointer if no page or no
+   memory for the frame table entry is available. */
+void *
+frame_alloc (enum palloc_flags flags, void *upage)
+{
+  struct frame *f;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  f = kmem_cache_alloc (&frame_cache);
+  if (f == NULL)
+    return NULL;
+  f->kpage = palloc_get_page (flags | PAL_USER);
+  if (f->kpage == NULL)
+    {
+      kmem_cache_free (&frame_cache, f);
+      return NULL;
+    }
+  f->upage = upage;
+  f->owner = thread_current ();
+
+  lock_acquire (&frame_lock);
+  hash_insert (&frames, &f->elem);
+  lock_release (&frame_lock);
+
+  return f->kpage;
+}
+
+/* Removes frame KPAGE, which must have been obtained with
+   frame_alloc(), from the frame table and frees it. */
+void
+frame_free (void *kpage)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = frame_lookup (kpage);
+  ASSERT (f != NULL);
+  hash_delete (&frames, &f->elem);
+  lock_release (&frame_lock);
+
+  palloc_free_page (f->kpage);
+  kmem_cache_free (&frame_cache, f);
+}
+
+/* Returns the frame whose kernel virtual address is KPAGE, or a
+   null pointer if there is none.  frame_lock must be held. */
+static struct frame *
+frame_lookup (void *kpage)
+{
+  struct frame f;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  f.kpage = kpage;
+  e = hash_find (&frames, &f.elem);
+  return e != NULL ? hash_entry (e, struct frame, elem) : NULL;
+}
+
+/* Returns a hash value for frame E. */
+static unsigned
+frame_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, elem);
+  return hash_bytes (&f->kpage, sizeof f->kpage);
+}
+
+/* Returns true if frame A precedes frame B. */
+static bool
+frame_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, elem);
+  const struct frame *b = hash_entry (b_, struct frame, elem);
+
+  return a->kpage < b->kpage;
+}
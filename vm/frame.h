@@ -0,0 +1,22 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+
+/* A frame: a page of the user pool that holds a page of some
+   process's virtual memory. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address of frame. */
+    void *upage;                /* User virtual address mapped to it. */
+    struct thread *owner;       /* Process that maps it. */
+    struct hash_elem elem;      /* Element in frame table. */
+  };
+
+void frame_init (void);
+void *frame_alloc (enum palloc_flags, void *upage);
+void frame_free (void *kpage);
+
+#endif /* vm/frame.h */
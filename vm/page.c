@@ -0,0 +1,215 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+
+/* Supplemental page tables.
+
+   Each process records the pages of its address space in a hash
+   table keyed by user virtual address: where each page's initial
+   contents come from and, once it has been loaded, the frame
+   that holds it.  load() fills in the table from the program
+   headers of the executable without reading any page of it, and
+   page_fault() calls page_load() to bring in each page the first
+   time it is touched, so starting a process takes time in
+   proportion to the pages it uses rather than to the size of its
+   image.
+
+   A process's table is only ever used by the process itself, so
+   it needs no lock. */
+
+/* Cache of `struct page's. */
+static struct kmem_cache page_cache;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static bool page_add (void *upage, struct file *, off_t ofs,
+                      size_t read_bytes, bool writable);
+static struct page *page_lookup (const void *upage);
+
+/* Initializes the page module. */
+void
+page_init (void)
+{
+  kmem_cache_create (&page_cache, "page", sizeof (struct page), NULL);
+}
+
+/* Initializes the running process's supplemental page table.
+   Returns true if successful, false on memory allocation
+   failure. */
+bool
+page_table_init (void)
+{
+  return hash_init (&thread_current ()->pages, page_hash, page_less, NULL);
+}
+
+/* Destroys the running process's supplemental page table,
+   unmapping and freeing the frames of the pages that were
+   loaded.  Must be called before the page directory is
+   destroyed. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&thread_current ()->pages, page_destroy);
+}
+
+/* Adds page UPAGE to the running process's address space, to be
+   loaded on first access with READ_BYTES bytes read from FILE
+   at offset OFS, followed by zeros.  FILE must stay open as long
+   as the process runs.  The page may be written by the process
+   if WRITABLE is true.  Returns true if successful, false if
+   UPAGE is already in the address space or on memory allocation
+   failure. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  ASSERT (file != NULL);
+  ASSERT (read_bytes <= PGSIZE);
+
+  return page_add (upage, file, ofs, read_bytes, writable);
+}
+
+/* Adds page UPAGE to the running process's address space, to be
+   filled with zeros on first access.  The page may be written by
+   the process if WRITABLE is true.  Returns true if successful,
+   false if UPAGE is already in the address space or on memory
+   allocation failure. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, NULL, 0, 0, writable);
+}
+
+/* Loads the page that contains ADDR in the running process's
+   address space into a new frame and maps it.  Returns true if
+   successful, false if ADDR is not in the address space, its
+   page is already loaded, no frame is available, or reading its
+   file fails. */
+bool
+page_load (const void *addr)
+{
+  struct page *p = page_lookup (pg_round_down (addr));
+  uint8_t *kpage;
+
+  if (p == NULL || p->kpage != NULL)
+    return false;
+
+  kpage = frame_alloc (p->read_bytes == 0 ? PAL_ZERO : 0, p->upage);
+  if (kpage == NULL)
+    return false;
+
+  if (p->read_bytes > 0)
+    {
+      /* The fault may have been taken by a system call that
+         already holds the file system lock. */
+      bool held = lock_held_by_current_thread (&file_lock);
+      off_t bytes_read;
+
+      if (!held)
+        lock_acquire (&file_lock);
+      bytes_read = file_read_at (p->file, kpage, p->read_bytes, p->ofs);
+      if (!held)
+        lock_release (&file_lock);
+
+      if (bytes_read != (off_t) p->read_bytes)
+        {
+          frame_free (kpage);
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+
+  if (!pagedir_set_page (thread_current ()->pagedir, p->upage, kpage,
+                         p->writable))
+    {
+      frame_free (kpage);
+      return false;
+    }
+  p->kpage = kpage;
+  return true;
+}
+
+/* Adds a page to the running process's supplemental page table.
+   See page_add_file() and page_add_zero(). */
+static bool
+page_add (void *upage, struct file *file, off_t ofs, size_t read_bytes,
+          bool writable)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = kmem_cache_alloc (&page_cache);
+  if (p == NULL)
+    return false;
+  p->upage = upage;
+  p->kpage = NULL;
+  p->writable = writable;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+
+  if (hash_insert (&thread_current ()->pages, &p->elem) != NULL)
+    {
+      kmem_cache_free (&page_cache, p);
+      return false;
+    }
+  return true;
+}
+
+/* Returns the page at UPAGE in the running process's address
+   space, or a null pointer if there is none. */
+static struct page *
+page_lookup (const void *upage)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = (void *) upage;
+  e = hash_find (&thread_current ()->pages, &p.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Unmaps and frees page E's frame, if it has one, and frees E.
+   Used by page_table_destroy(). */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, elem);
+
+  if (p->kpage != NULL)
+    {
+      pagedir_clear_page (thread_current ()->pagedir, p->upage);
+      frame_free (p->kpage);
+    }
+  kmem_cache_free (&page_cache, p);
+}
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, elem);
+  const struct page *b = hash_entry (b_, struct page, elem);
+
+  return a->upage < b->upage;
+}
@@ -0,0 +1,36 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct file;
+
+/* A page of a process's virtual memory, as recorded in its
+   supplemental page table. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    void *kpage;                /* Frame, or null if not loaded. */
+    bool writable;              /* May the process write to it? */
+
+    /* Initial contents: READ_BYTES bytes from FILE at offset OFS,
+       followed by zeros.  FILE is null for an all-zero page. */
+    struct file *file;
+    off_t ofs;
+    size_t read_bytes;
+
+    struct hash_elem elem;      /* Element in supplemental page table. */
+  };
+
+void page_init (void);
+bool page_table_init (void);
+void page_table_destroy (void);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_load (const void *addr);
+
+#endif /* vm/page.h */